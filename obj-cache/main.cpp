@@ -0,0 +1,243 @@
+// obj-cache - builds obj-viewer binary caches without a window or GL context,
+// and checks the cpu occlusion buffer against a model the same way
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <filesystem>
+#include <cstdlib>
+#include <cctype>
+#include <fstream>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "obj_file.h"
+#include "mesh_data.h"
+#include "cache.h"
+#include "bounds.h"
+#include "geometry.h"
+#include "occlusion.h"
+
+using namespace obj_viewer;
+
+class job {
+public:
+	std::filesystem::path input;
+	std::filesystem::path output;
+};
+
+static std::mutex output_mutex;
+
+static bool build_cache(const job& job) {
+	const auto start = std::chrono::steady_clock::now();
+
+	obj_file file;
+	if (!parse_obj(job.input.string(), file))
+		return false;
+
+	std::vector<mesh_data> meshes = build_meshes(file.attrib, file.shapes, file.materials, file.path);
+	file.attrib = tinyobj::attrib_t();
+	file.shapes.clear();
+
+	size_t triangles = 0;
+	size_t vertices = 0;
+	std::vector<cached_mesh> cached_meshes;
+	cached_meshes.reserve(meshes.size());
+	for (mesh_data& mesh : meshes) {
+		cached_meshes.push_back(process_mesh(std::move(mesh)));
+		triangles += cached_meshes.back().indices.size() / 3;
+		vertices += cached_meshes.back().vertices.size();
+	}
+
+	std::error_code error;
+	if (job.output.has_parent_path() && !std::filesystem::create_directories(job.output.parent_path(), error) && error) {
+		std::lock_guard<std::mutex> lock(output_mutex);
+		std::cerr << "cannot create directory : " << job.output.parent_path().string() << " : " << error.message() << '\n';
+		return false;
+	}
+	if (!write_cache(job.output.string(), cached_meshes))
+		return false;
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	std::lock_guard<std::mutex> lock(output_mutex);
+	std::cout << job.input.string() << " -> " << job.output.string() << " : " << triangles << " triangles, " << vertices << " vertices, " << elapsed.count() << "s\n";
+	return true;
+}
+
+// renders the occluder proxies of a model into the occlusion buffer from the viewer's starting view,
+// counts the meshes it hides and writes the buffer as a binary PGM, nearer being brighter
+static bool check_occlusion(const std::filesystem::path& input, const std::filesystem::path& image) {
+	obj_file file;
+	if (!parse_obj(input.string(), file))
+		return false;
+	const std::vector<mesh_data> meshes = build_meshes(file.attrib, file.shapes, file.materials, file.path);
+
+	std::vector<bounding_volume> bounds(meshes.size());
+	bounding_volume scene;
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		bounds[m].assign(meshes[m].vertices.positions);
+		scene.merge(bounds[m]);
+	}
+	if (scene.empty())
+		return false;
+
+	// fitted like object::fit and seen like the viewer's first frame
+	const glm::vec3 size = scene.max - scene.min;
+	const float scale = 2.0f / std::max({ size.x, size.y, size.z, 1e-6f });
+	const glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(scale)) * glm::translate(glm::mat4(1.0f), (scene.min + scene.max) * -0.5f);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 4.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const glm::mat4 clip = glm::perspective(glm::radians(50.0f), 1.0f, 0.1f, 100.0f) * view * model;
+
+	std::vector<std::vector<glm::vec3>> proxies(meshes.size());
+	std::vector<occluder> occluders;
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		proxies[m] = occluder_proxy(meshes[m].vertices.positions, meshes[m].indices, 4096);
+		if (!proxies[m].empty())
+			occluders.push_back({ &proxies[m], clip, bounds[m].radius });
+	}
+	occlusion_buffer buffer;
+	buffer.begin(800, 800);
+	buffer.render(occluders);
+
+	size_t hidden = 0;
+	for (const bounding_volume& box : bounds) {
+		if (!box.empty() && buffer.occluded(box.min, box.max, clip))
+			++hidden;
+	}
+
+	const std::vector<float>& depth = buffer.depth();
+	const float nearest = depth.empty() ? 0.0f : *std::max_element(depth.begin(), depth.end());
+	const size_t covered = size_t(std::count_if(depth.begin(), depth.end(), [](float d) { return d > 0.0f; }));
+	std::ofstream out(image, std::ios::binary);
+	out << "P5\n" << buffer.width() << ' ' << buffer.height() << "\n255\n";
+	// the buffer starts at the bottom row, the image at the top one
+	for (int row = buffer.height(); row-- > 0;) {
+		for (int column = 0; column < buffer.width(); ++column) {
+			const float value = depth[size_t(row) * buffer.width() + column];
+			out.put(char(nearest > 0.0f ? (unsigned char)std::lround(255.0f * value / nearest) : 0));
+		}
+	}
+	if (!out)
+		return false;
+
+	std::cout << input.string() << " -> " << image.string() << " : " << buffer.width() << "x" << buffer.height() << ", "
+		<< occluders.size() << " occluders, " << 100.0 * covered / std::max<size_t>(depth.size(), 1) << "% covered, "
+		<< hidden << "/" << meshes.size() << " meshes hidden\n";
+	return true;
+}
+
+// false when the input cannot be read, though the files listed before the error are still added
+static bool add_jobs(const std::filesystem::path& input, const std::filesystem::path& output_directory, std::vector<job>& jobs) {
+	auto output_of = [&output_directory](const std::filesystem::path& file, const std::filesystem::path& relative) {
+		std::filesystem::path output = output_directory.empty() ? file : output_directory / relative;
+		return output.replace_extension(".objcache");
+	};
+
+	std::error_code error;
+	if (!std::filesystem::is_directory(input, error)) {
+		jobs.push_back({ input, output_of(input, input.filename()) });
+		return true;
+	}
+
+	std::filesystem::recursive_directory_iterator entry(input, error);
+	for (; !error && entry != std::filesystem::recursive_directory_iterator(); entry.increment(error)) {
+		std::error_code type_error;
+		if (entry->is_regular_file(type_error) && file_extension(entry->path().string()) == ".obj")
+			jobs.push_back({ entry->path(), output_of(entry->path(), entry->path().lexically_relative(input)) });
+	}
+	if (error) {
+		std::cerr << "cannot read directory : " << input.string() << " : " << error.message() << '\n';
+		return false;
+	}
+	return true;
+}
+
+static bool parse_job_count(const char* text, unsigned int& job_count) {
+	if (!isdigit(static_cast<unsigned char>(text[0])))
+		return false;
+	char* end = NULL;
+	const unsigned long value = strtoul(text, &end, 10);
+	if (*end != '\0' || value == 0 || value > 1024)
+		return false;
+	job_count = static_cast<unsigned int>(value);
+	return true;
+}
+
+int main(int argc, char** argv) {
+	unsigned int job_count = std::max(1u, std::thread::hardware_concurrency());
+	std::filesystem::path output_directory;
+	std::filesystem::path occlusion_image;
+	std::vector<std::filesystem::path> inputs;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "-j" && i + 1 < argc) {
+			if (!parse_job_count(argv[++i], job_count)) {
+				std::cerr << "invalid job count : " << argv[i] << '\n';
+				return 1;
+			}
+		}
+		else if (arg == "-o" && i + 1 < argc)
+			output_directory = argv[++i];
+		else if (arg == "--occlusion" && i + 1 < argc)
+			occlusion_image = argv[++i];
+		else
+			inputs.push_back(arg);
+	}
+
+	if (!occlusion_image.empty()) {
+		std::error_code error;
+		if (inputs.size() != 1 || std::filesystem::is_directory(inputs[0], error)) {
+			std::cout << "usage : obj-cache --occlusion <image.pgm> <.obj file>\n";
+			return 1;
+		}
+		if (!check_occlusion(inputs[0], occlusion_image)) {
+			std::cerr << "failed : " << inputs[0].string() << '\n';
+			return 1;
+		}
+		return 0;
+	}
+
+	std::vector<job> jobs;
+	size_t unreadable = 0;
+	for (const auto& input : inputs) {
+		if (!add_jobs(input, output_directory, jobs)) {
+			std::cerr << "failed : " << input.string() << '\n';
+			unreadable++;
+		}
+	}
+
+	if (jobs.empty()) {
+		if (unreadable > 0)
+			return 1;
+		std::cout << "usage : obj-cache [-j jobs] [-o output directory] <.obj file or directory>...\n";
+		std::cout << "        obj-cache --occlusion <image.pgm> <.obj file>\n";
+		return 1;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	std::atomic<size_t> next(0);
+	std::atomic<size_t> failed(0);
+	std::vector<std::thread> workers;
+	for (unsigned int w = 0; w < std::min<size_t>(job_count, jobs.size()); ++w) {
+		workers.emplace_back([&]() {
+			for (size_t j = next++; j < jobs.size(); j = next++) {
+				if (!build_cache(jobs[j])) {
+					std::lock_guard<std::mutex> lock(output_mutex);
+					std::cerr << "failed : " << jobs[j].input.string() << '\n';
+					failed++;
+				}
+			}
+		});
+	}
+	for (auto& worker : workers)
+		worker.join();
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << jobs.size() - failed << "/" << jobs.size() << " caches built with " << workers.size() << " jobs in " << elapsed.count() << "s\n";
+	return failed == 0 && unreadable == 0 ? 0 : 1;
+}
@@ -2,6 +2,7 @@
 #pragma warning(disable:6386)
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
 #include <GL/glew.h>
 #include <GL/glut.h>
@@ -28,9 +29,11 @@ readShaderSource(const char* shaderFile)
 }
 
 
-// Create a GLSL program object from vertex and fragment shader files
+// Create a GLSL program object from vertex and fragment shader files,
+// inserting the given #define lines right after the #version line.
+// A define block starting with its own #version line replaces the file's one
 GLuint
-InitShader(const char* vShaderFile, const char* fShaderFile)
+InitShader(const char* vShaderFile, const char* fShaderFile, const char* defines)
 {
     struct Shader {
 	const char*  filename;
@@ -51,8 +54,13 @@ InitShader(const char* vShaderFile, const char* fShaderFile)
 	    exit( EXIT_FAILURE );
 	}
 
+	char* body = strchr( s.source, '\n' );
+	body = body == NULL ? s.source + strlen( s.source ) : body + 1;
+	const GLchar* sources[3] = { s.source, defines, body };
+	const GLint lengths[3] = { strncmp( defines, "#version", 8 ) == 0 ? 0 : GLint( body - s.source ), -1, -1 };
+
 	GLuint shader = glCreateShader( s.type );
-	glShaderSource( shader, 1, (const GLchar**) &s.source, NULL );
+	glShaderSource( shader, 3, sources, lengths );
 	glCompileShader( shader );
 
 	GLint  compiled;
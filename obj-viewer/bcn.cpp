@@ -0,0 +1,380 @@
+#include "bcn.h"
+
+#include <cmath> // log10
+#include <thread> // thread
+#include <algorithm> // min max swap
+#include <cstring> // memcpy
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BCN_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace obj_viewer {
+
+	compressed_image::compressed_image() : width(0), height(0), format(block_format::none), hash(0) {
+		// nop
+	}
+
+	block_format parse_block_format(const std::string& name) {
+		if (name == "auto") return block_format::automatic;
+		if (name == "bc1") return block_format::bc1;
+		if (name == "bc3") return block_format::bc3;
+		if (name == "bc5") return block_format::bc5;
+		return block_format::none;
+	}
+
+	const char* block_format_name(block_format format) {
+		switch (format) {
+		case block_format::automatic: return "auto";
+		case block_format::bc1: return "bc1";
+		case block_format::bc3: return "bc3";
+		case block_format::bc5: return "bc5";
+		default: return "none";
+		}
+	}
+
+	block_format choose_block_format(const image& image, block_format requested) {
+		if (requested != block_format::automatic)
+			return requested;
+		if (image.components == 4) {
+			for (size_t i = 3; i < image.pixels.size(); i += 4) {
+				if (image.pixels[i] != 255)
+					return block_format::bc3;
+			}
+		}
+		return block_format::bc1;
+	}
+
+	static size_t block_size(block_format format) {
+		return format == block_format::bc1 ? 8 : 16;
+	}
+
+	static void load_block(const image& image, int bx, int by, unsigned char block[64]) {
+		for (int y = 0; y < 4; ++y) {
+			const int sy = std::min(by * 4 + y, image.height - 1);
+			for (int x = 0; x < 4; ++x) {
+				const int sx = std::min(bx * 4 + x, image.width - 1);
+				const unsigned char* pixel = &image.pixels[(size_t(sy) * image.width + sx) * image.components];
+				unsigned char* out = block + (y * 4 + x) * 4;
+				out[0] = pixel[0];
+				out[1] = pixel[1];
+				out[2] = pixel[2];
+				out[3] = image.components == 4 ? pixel[3] : 255;
+			}
+		}
+	}
+
+	static void color_bounds(const unsigned char block[64], unsigned char min[4], unsigned char max[4]) {
+#ifdef BCN_SSE2
+		const __m128i* rows = reinterpret_cast<const __m128i*>(block);
+		__m128i low = _mm_min_epu8(_mm_min_epu8(_mm_loadu_si128(rows + 0), _mm_loadu_si128(rows + 1)), _mm_min_epu8(_mm_loadu_si128(rows + 2), _mm_loadu_si128(rows + 3)));
+		__m128i high = _mm_max_epu8(_mm_max_epu8(_mm_loadu_si128(rows + 0), _mm_loadu_si128(rows + 1)), _mm_max_epu8(_mm_loadu_si128(rows + 2), _mm_loadu_si128(rows + 3)));
+		low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(1, 0, 3, 2)));
+		high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(1, 0, 3, 2)));
+		low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(2, 3, 0, 1)));
+		high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(2, 3, 0, 1)));
+		const int packed_min = _mm_cvtsi128_si32(low);
+		const int packed_max = _mm_cvtsi128_si32(high);
+		memcpy(min, &packed_min, 4);
+		memcpy(max, &packed_max, 4);
+#else
+		for (int c = 0; c < 4; ++c) {
+			min[c] = 255;
+			max[c] = 0;
+		}
+		for (int i = 0; i < 16; ++i) {
+			for (int c = 0; c < 4; ++c) {
+				min[c] = std::min(min[c], block[i * 4 + c]);
+				max[c] = std::max(max[c], block[i * 4 + c]);
+			}
+		}
+#endif
+	}
+
+	static std::uint16_t to_565(const unsigned char color[4]) {
+		return std::uint16_t(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255));
+	}
+
+	static void from_565(std::uint16_t value, unsigned char color[4]) {
+		const int r = (value >> 11) & 31;
+		const int g = (value >> 5) & 63;
+		const int b = value & 31;
+		color[0] = static_cast<unsigned char>((r << 3) | (r >> 2));
+		color[1] = static_cast<unsigned char>((g << 2) | (g >> 4));
+		color[2] = static_cast<unsigned char>((b << 3) | (b >> 2));
+		color[3] = 0;
+	}
+
+	static std::uint32_t select_color_indices(const unsigned char block[64], const unsigned char palette[4][4]) {
+		std::uint32_t result = 0;
+#ifdef BCN_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i rgb_mask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+		__m128i colors[4];
+		for (int k = 0; k < 4; ++k) {
+			int packed;
+			memcpy(&packed, palette[k], 4);
+			colors[k] = _mm_unpacklo_epi8(_mm_set1_epi32(packed), zero);
+		}
+
+		for (int i = 0; i < 16; i += 4) {
+			const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 4));
+			const __m128i low = _mm_unpacklo_epi8(pixels, zero);
+			const __m128i high = _mm_unpackhi_epi8(pixels, zero);
+			__m128i best_distance = _mm_set1_epi32(0x7fffffff);
+			__m128i best_index = zero;
+
+			for (int k = 0; k < 4; ++k) {
+				const __m128i low_delta = _mm_and_si128(_mm_sub_epi16(low, colors[k]), rgb_mask);
+				const __m128i high_delta = _mm_and_si128(_mm_sub_epi16(high, colors[k]), rgb_mask);
+				const __m128 low_sums = _mm_castsi128_ps(_mm_madd_epi16(low_delta, low_delta));
+				const __m128 high_sums = _mm_castsi128_ps(_mm_madd_epi16(high_delta, high_delta));
+				const __m128i distance = _mm_add_epi32(
+					_mm_castps_si128(_mm_shuffle_ps(low_sums, high_sums, _MM_SHUFFLE(2, 0, 2, 0))),
+					_mm_castps_si128(_mm_shuffle_ps(low_sums, high_sums, _MM_SHUFFLE(3, 1, 3, 1))));
+				const __m128i closer = _mm_cmplt_epi32(distance, best_distance);
+				best_distance = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, best_distance));
+				best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, best_index));
+			}
+
+			int indices[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(indices), best_index);
+			for (int p = 0; p < 4; ++p)
+				result |= std::uint32_t(indices[p]) << ((i + p) * 2);
+		}
+#else
+		for (int i = 0; i < 16; ++i) {
+			int best_distance = 0x7fffffff;
+			int best_index = 0;
+			for (int k = 0; k < 4; ++k) {
+				int distance = 0;
+				for (int c = 0; c < 3; ++c) {
+					const int delta = block[i * 4 + c] - palette[k][c];
+					distance += delta * delta;
+				}
+				if (distance < best_distance) {
+					best_distance = distance;
+					best_index = k;
+				}
+			}
+			result |= std::uint32_t(best_index) << (i * 2);
+		}
+#endif
+		return result;
+	}
+
+	static void encode_color_block(const unsigned char block[64], unsigned char* out) {
+		unsigned char min[4], max[4];
+		color_bounds(block, min, max);
+
+		int mean[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; ++i) {
+			for (int c = 0; c < 3; ++c)
+				mean[c] += block[i * 4 + c];
+		}
+		int covariance_rg = 0, covariance_bg = 0;
+		for (int i = 0; i < 16; ++i) {
+			const int g = block[i * 4 + 1] * 16 - mean[1];
+			covariance_rg += (block[i * 4 + 0] * 16 - mean[0]) * g;
+			covariance_bg += (block[i * 4 + 2] * 16 - mean[2]) * g;
+		}
+
+		for (int c = 0; c < 3; ++c) {
+			const int inset = (max[c] - min[c]) >> 4;
+			min[c] = static_cast<unsigned char>(min[c] + inset);
+			max[c] = static_cast<unsigned char>(max[c] - inset);
+		}
+		if (covariance_rg < 0)
+			std::swap(min[0], max[0]);
+		if (covariance_bg < 0)
+			std::swap(min[2], max[2]);
+
+		std::uint16_t c0 = to_565(max);
+		std::uint16_t c1 = to_565(min);
+		if (c0 < c1)
+			std::swap(c0, c1);
+
+		std::uint32_t indices = 0;
+		if (c0 != c1) {
+			unsigned char palette[4][4];
+			from_565(c0, palette[0]);
+			from_565(c1, palette[1]);
+			for (int c = 0; c < 4; ++c) {
+				palette[2][c] = static_cast<unsigned char>((2 * palette[0][c] + palette[1][c]) / 3);
+				palette[3][c] = static_cast<unsigned char>((palette[0][c] + 2 * palette[1][c]) / 3);
+			}
+			indices = select_color_indices(block, palette);
+		}
+
+		out[0] = static_cast<unsigned char>(c0 & 0xff);
+		out[1] = static_cast<unsigned char>(c0 >> 8);
+		out[2] = static_cast<unsigned char>(c1 & 0xff);
+		out[3] = static_cast<unsigned char>(c1 >> 8);
+		for (int i = 0; i < 4; ++i)
+			out[4 + i] = static_cast<unsigned char>(indices >> (i * 8));
+	}
+
+	static void encode_channel_block(const unsigned char block[64], int channel, unsigned char* out) {
+		int min = 255, max = 0;
+		for (int i = 0; i < 16; ++i) {
+			min = std::min<int>(min, block[i * 4 + channel]);
+			max = std::max<int>(max, block[i * 4 + channel]);
+		}
+
+		std::uint64_t bits = std::uint64_t(max) | std::uint64_t(min) << 8;
+		if (max != min) {
+			const int range = max - min;
+			for (int i = 0; i < 16; ++i) {
+				const int step = ((max - block[i * 4 + channel]) * 7 + range / 2) / range;
+				const int index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+				bits |= std::uint64_t(index) << (16 + i * 3);
+			}
+		}
+		for (int i = 0; i < 8; ++i)
+			out[i] = static_cast<unsigned char>(bits >> (i * 8));
+	}
+
+	static void compress_rows(const image& image, block_format format, int first_row, int last_row, unsigned char* out) {
+		const int blocks_x = (image.width + 3) / 4;
+		const size_t size = block_size(format);
+		unsigned char block[64];
+
+		for (int by = first_row; by < last_row; ++by) {
+			for (int bx = 0; bx < blocks_x; ++bx) {
+				unsigned char* target = out + (size_t(by) * blocks_x + bx) * size;
+				load_block(image, bx, by, block);
+				if (format == block_format::bc1) {
+					encode_color_block(block, target);
+				}
+				else if (format == block_format::bc3) {
+					encode_channel_block(block, 3, target);
+					encode_color_block(block, target + 8);
+				}
+				else {
+					encode_channel_block(block, 0, target);
+					encode_channel_block(block, 1, target + 8);
+				}
+			}
+		}
+	}
+
+	compressed_image compress(const image& image, block_format format, size_t threads) {
+		compressed_image result;
+		format = choose_block_format(image, format);
+		if (format == block_format::none || image.width <= 0 || image.height <= 0)
+			return result;
+
+		const int blocks_x = (image.width + 3) / 4;
+		const int blocks_y = (image.height + 3) / 4;
+		result.width = image.width;
+		result.height = image.height;
+		result.format = format;
+		result.hash = image.hash;
+		result.blocks.resize(size_t(blocks_x) * blocks_y * block_size(format));
+
+		threads = std::max<size_t>(1, std::min<size_t>(threads, size_t(blocks_y)));
+		std::vector<std::thread> workers;
+		for (size_t t = 1; t < threads; ++t) {
+			const int first = int(blocks_y * t / threads);
+			const int last = int(blocks_y * (t + 1) / threads);
+			workers.emplace_back(compress_rows, std::cref(image), format, first, last, result.blocks.data());
+		}
+		compress_rows(image, format, 0, int(blocks_y / threads), result.blocks.data());
+		for (auto& worker : workers)
+			worker.join();
+		return result;
+	}
+
+	static void decode_color_block(const unsigned char* in, bool four_colors, unsigned char block[64]) {
+		const std::uint16_t c0 = std::uint16_t(in[0] | in[1] << 8);
+		const std::uint16_t c1 = std::uint16_t(in[2] | in[3] << 8);
+		unsigned char palette[4][4];
+		from_565(c0, palette[0]);
+		from_565(c1, palette[1]);
+		for (int c = 0; c < 3; ++c) {
+			if (four_colors || c0 > c1) {
+				palette[2][c] = static_cast<unsigned char>((2 * palette[0][c] + palette[1][c]) / 3);
+				palette[3][c] = static_cast<unsigned char>((palette[0][c] + 2 * palette[1][c]) / 3);
+			}
+			else {
+				palette[2][c] = static_cast<unsigned char>((palette[0][c] + palette[1][c]) / 2);
+				palette[3][c] = 0;
+			}
+		}
+
+		const std::uint32_t indices = std::uint32_t(in[4] | in[5] << 8 | in[6] << 16 | std::uint32_t(in[7]) << 24);
+		for (int i = 0; i < 16; ++i)
+			memcpy(block + i * 4, palette[(indices >> (i * 2)) & 3], 3);
+	}
+
+	static void decode_channel_block(const unsigned char* in, int channel, unsigned char block[64]) {
+		int values[8] = { in[0], in[1] };
+		for (int i = 1; i < 7; ++i)
+			values[i + 1] = in[0] > in[1] ? ((7 - i) * in[0] + i * in[1]) / 7 : i < 5 ? ((5 - i) * in[0] + i * in[1]) / 5 : i == 5 ? 0 : 255;
+
+		std::uint64_t bits = 0;
+		for (int i = 0; i < 6; ++i)
+			bits |= std::uint64_t(in[2 + i]) << (i * 8);
+		for (int i = 0; i < 16; ++i)
+			block[i * 4 + channel] = static_cast<unsigned char>(values[(bits >> (i * 3)) & 7]);
+	}
+
+	image decompress(const compressed_image& compressed) {
+		image result;
+		result.width = compressed.width;
+		result.height = compressed.height;
+		result.components = 4;
+		result.hash = compressed.hash;
+		result.pixels.resize(size_t(result.width) * result.height * 4);
+
+		const int blocks_x = (compressed.width + 3) / 4;
+		const int blocks_y = (compressed.height + 3) / 4;
+		const size_t size = block_size(compressed.format);
+		unsigned char block[64];
+
+		for (int by = 0; by < blocks_y; ++by) {
+			for (int bx = 0; bx < blocks_x; ++bx) {
+				const unsigned char* in = &compressed.blocks[(size_t(by) * blocks_x + bx) * size];
+				memset(block, 255, sizeof(block));
+				if (compressed.format == block_format::bc1) {
+					decode_color_block(in, false, block);
+				}
+				else if (compressed.format == block_format::bc3) {
+					decode_channel_block(in, 3, block);
+					decode_color_block(in + 8, true, block);
+				}
+				else {
+					decode_channel_block(in, 0, block);
+					decode_channel_block(in + 8, 1, block);
+				}
+
+				for (int y = 0; y < 4 && by * 4 + y < result.height; ++y) {
+					for (int x = 0; x < 4 && bx * 4 + x < result.width; ++x)
+						memcpy(&result.pixels[((size_t(by) * 4 + y) * result.width + bx * 4 + x) * 4], block + (y * 4 + x) * 4, 4);
+				}
+			}
+		}
+		return result;
+	}
+
+	double psnr(const image& original, const image& decoded, block_format format) {
+		const int channels = format == block_format::bc5 ? 2 : format == block_format::bc3 ? 4 : 3;
+		const size_t pixels = size_t(original.width) * original.height;
+		double error = 0.0;
+		size_t samples = 0;
+
+		for (size_t i = 0; i < pixels; ++i) {
+			for (int c = 0; c < channels; ++c) {
+				const int source = c < original.components ? original.pixels[i * original.components + c] : 255;
+				const double delta = double(source) - decoded.pixels[i * decoded.components + c];
+				error += delta * delta;
+				++samples;
+			}
+		}
+
+		if (samples == 0 || error == 0.0)
+			return 99.0;
+		return 10.0 * std::log10(255.0 * 255.0 / (error / samples));
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include <cstdint> // uint64_t
+#include "object.h" // image
+
+namespace obj_viewer {
+
+	enum class block_format { none, automatic, bc1, bc3, bc5 };
+
+	class compressed_image {
+	public:
+		int width;
+		int height;
+		block_format format;
+		std::uint64_t hash;
+		std::vector<unsigned char> blocks;
+
+		compressed_image();
+	};
+
+	block_format parse_block_format(const std::string& name);
+	const char* block_format_name(block_format format);
+	block_format choose_block_format(const image& image, block_format requested);
+
+	compressed_image compress(const image& image, block_format format, size_t threads);
+	image decompress(const compressed_image& compressed);
+	double psnr(const image& original, const image& decoded, block_format format);
+}
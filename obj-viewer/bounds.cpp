@@ -0,0 +1,102 @@
+#include "bounds.h"
+
+#include <algorithm> // max
+#include <cmath> // abs sqrt
+#include <limits> // numeric_limits
+#include <glm/glm.hpp> // min max length
+
+namespace obj_viewer {
+
+	bounding_volume::bounding_volume()
+		: min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max()), center(0.0f), radius(0.0f) {
+		// nop
+	}
+
+	void bounding_volume::assign(const std::vector<glm::vec3>& points) {
+		*this = bounding_volume();
+		for (const glm::vec3& point : points) {
+			min = glm::min(min, point);
+			max = glm::max(max, point);
+		}
+		if (empty())
+			return;
+
+		center = (min + max) * 0.5f;
+		float squared = 0.0f;
+		for (const glm::vec3& point : points) {
+			const glm::vec3 d = point - center;
+			squared = std::max(squared, glm::dot(d, d));
+		}
+		radius = std::sqrt(squared);
+	}
+
+	void bounding_volume::merge(const bounding_volume& other) {
+		if (other.empty())
+			return;
+		if (empty()) {
+			*this = other;
+			return;
+		}
+		const glm::vec3 merged_center = (glm::min(min, other.min) + glm::max(max, other.max)) * 0.5f;
+		radius = std::max(glm::length(center - merged_center) + radius, glm::length(other.center - merged_center) + other.radius);
+		center = merged_center;
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	bool bounding_volume::empty() const {
+		return min.x > max.x || min.y > max.y || min.z > max.z;
+	}
+
+	bounding_volume bounding_volume::transformed(const glm::mat4& transform) const {
+		if (empty())
+			return *this;
+
+		// box of the transformed box, the sphere grows with the largest axis scale
+		const glm::vec3 box_center = glm::vec3(transform * glm::vec4((min + max) * 0.5f, 1.0f));
+		const glm::vec3 extent = (max - min) * 0.5f;
+		glm::vec3 box_extent(0.0f);
+		for (int row = 0; row < 3; ++row) {
+			for (int column = 0; column < 3; ++column)
+				box_extent[row] += std::abs(transform[column][row]) * extent[column];
+		}
+		const float scale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+
+		bounding_volume result;
+		result.min = box_center - box_extent;
+		result.max = box_center + box_extent;
+		result.center = glm::vec3(transform * glm::vec4(center, 1.0f));
+		result.radius = radius * scale;
+		return result;
+	}
+
+	frustum::frustum(const glm::mat4& clip) {
+		const glm::vec4 row[4] = {
+			glm::vec4(clip[0][0], clip[1][0], clip[2][0], clip[3][0]),
+			glm::vec4(clip[0][1], clip[1][1], clip[2][1], clip[3][1]),
+			glm::vec4(clip[0][2], clip[1][2], clip[2][2], clip[3][2]),
+			glm::vec4(clip[0][3], clip[1][3], clip[2][3], clip[3][3])
+		};
+		for (int axis = 0; axis < 3; ++axis) {
+			planes[axis * 2] = row[3] + row[axis];
+			planes[axis * 2 + 1] = row[3] - row[axis];
+		}
+		for (glm::vec4& plane : planes)
+			plane /= glm::length(glm::vec3(plane));
+	}
+
+	containment frustum::classify(const glm::vec3& min, const glm::vec3& max) const {
+		const glm::vec3 center = (min + max) * 0.5f;
+		const glm::vec3 extent = (max - min) * 0.5f;
+		containment result = containment::inside;
+		for (const glm::vec4& plane : planes) {
+			const float d = glm::dot(glm::vec3(plane), center) + plane.w;
+			const float r = glm::dot(glm::abs(glm::vec3(plane)), extent);
+			if (d + r < 0.0f)
+				return containment::outside;
+			if (d - r < 0.0f)
+				result = containment::intersecting;
+		}
+		return result;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector> // vector
+#include <glm/vec3.hpp> // vec3
+#include <glm/vec4.hpp> // vec4
+#include <glm/mat4x4.hpp> // mat4
+
+namespace obj_viewer {
+
+	// axis aligned box and enclosing sphere of a set of points, empty when min > max
+	class bounding_volume {
+	public:
+		glm::vec3 min;
+		glm::vec3 max;
+		glm::vec3 center;
+		float radius;
+
+		bounding_volume();
+		void assign(const std::vector<glm::vec3>& points);
+		void merge(const bounding_volume& other);
+		bool empty() const;
+		bounding_volume transformed(const glm::mat4& transform) const;
+	};
+
+	enum class containment { outside, intersecting, inside };
+
+	// the six planes of a clip matrix, normalized and pointing inwards
+	class frustum {
+	public:
+		glm::vec4 planes[6];
+
+		frustum(const glm::mat4& clip);
+		containment classify(const glm::vec3& min, const glm::vec3& max) const;
+	};
+}
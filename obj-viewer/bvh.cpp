@@ -0,0 +1,224 @@
+#include "bvh.h"
+
+#include <cstdlib> // abs
+
+namespace obj_viewer {
+
+	static float surface(const glm::vec3& min, const glm::vec3& max) {
+		const glm::vec3 d = max - min;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	bvh::bvh() : _root(null_node), _free(null_node), _leaves(0) {
+		// nop
+	}
+
+	void bvh::clear() {
+		_nodes.clear();
+		_root = null_node;
+		_free = null_node;
+		_leaves = 0;
+	}
+
+	int bvh::allocate() {
+		if (_free == null_node) {
+			_nodes.push_back(node());
+			_free = int(_nodes.size()) - 1;
+			_nodes[_free].parent = null_node;
+		}
+		const int index = _free;
+		_free = _nodes[index].parent;
+		node& node = _nodes[index];
+		node.parent = null_node;
+		node.left = null_node;
+		node.right = null_node;
+		node.item = 0;
+		node.height = 0;
+		return index;
+	}
+
+	void bvh::release(int index) {
+		// free nodes are chained through their parent
+		_nodes[index].parent = _free;
+		_nodes[index].height = -1;
+		_free = index;
+	}
+
+	int bvh::insert(const bounding_volume& box, size_t item) {
+		const int leaf = allocate();
+		const glm::vec3 margin = (box.max - box.min) * 0.1f;
+		_nodes[leaf].min = box.min - margin;
+		_nodes[leaf].max = box.max + margin;
+		_nodes[leaf].item = item;
+		insert_leaf(leaf);
+		++_leaves;
+		return leaf;
+	}
+
+	void bvh::remove(int proxy) {
+		remove_leaf(proxy);
+		release(proxy);
+		--_leaves;
+	}
+
+	bool bvh::update(int proxy, const bounding_volume& box) {
+		const node& leaf = _nodes[proxy];
+		if (glm::all(glm::lessThanEqual(leaf.min, box.min)) && glm::all(glm::lessThanEqual(box.max, leaf.max)))
+			return false;
+
+		remove_leaf(proxy);
+		const glm::vec3 margin = (box.max - box.min) * 0.1f;
+		_nodes[proxy].min = box.min - margin;
+		_nodes[proxy].max = box.max + margin;
+		insert_leaf(proxy);
+		return true;
+	}
+
+	size_t bvh::item(int proxy) const {
+		return _nodes[proxy].item;
+	}
+
+	int bvh::height() const {
+		return _root == null_node ? 0 : _nodes[_root].height;
+	}
+
+	size_t bvh::size() const {
+		return _leaves;
+	}
+
+	void bvh::insert_leaf(int leaf) {
+		if (_root == null_node) {
+			_root = leaf;
+			_nodes[leaf].parent = null_node;
+			return;
+		}
+
+		// walk down to the sibling whose combined box grows the surface area the least
+		const glm::vec3 leaf_min = _nodes[leaf].min;
+		const glm::vec3 leaf_max = _nodes[leaf].max;
+		int index = _root;
+		while (!_nodes[index].leaf()) {
+			const node& current = _nodes[index];
+			const float area = surface(current.min, current.max);
+			const float combined = surface(glm::min(current.min, leaf_min), glm::max(current.max, leaf_max));
+			const float cost = 2.0f * combined;
+			const float inheritance = 2.0f * (combined - area);
+
+			float child_cost[2];
+			const int children[2] = { current.left, current.right };
+			for (int c = 0; c < 2; ++c) {
+				const node& child = _nodes[children[c]];
+				const float grown = surface(glm::min(child.min, leaf_min), glm::max(child.max, leaf_max));
+				child_cost[c] = child.leaf() ? grown + inheritance : grown - surface(child.min, child.max) + inheritance;
+			}
+			if (cost < child_cost[0] && cost < child_cost[1])
+				break;
+			index = child_cost[0] < child_cost[1] ? current.left : current.right;
+		}
+
+		const int sibling = index;
+		const int old_parent = _nodes[sibling].parent;
+		const int parent = allocate();
+		_nodes[parent].parent = old_parent;
+		_nodes[parent].min = glm::min(_nodes[sibling].min, leaf_min);
+		_nodes[parent].max = glm::max(_nodes[sibling].max, leaf_max);
+		_nodes[parent].height = _nodes[sibling].height + 1;
+		_nodes[parent].left = sibling;
+		_nodes[parent].right = leaf;
+		_nodes[sibling].parent = parent;
+		_nodes[leaf].parent = parent;
+		if (old_parent == null_node)
+			_root = parent;
+		else if (_nodes[old_parent].left == sibling)
+			_nodes[old_parent].left = parent;
+		else
+			_nodes[old_parent].right = parent;
+
+		refit(_nodes[leaf].parent);
+	}
+
+	void bvh::remove_leaf(int leaf) {
+		if (leaf == _root) {
+			_root = null_node;
+			return;
+		}
+
+		const int parent = _nodes[leaf].parent;
+		const int grandparent = _nodes[parent].parent;
+		const int sibling = _nodes[parent].left == leaf ? _nodes[parent].right : _nodes[parent].left;
+		release(parent);
+		if (grandparent == null_node) {
+			_root = sibling;
+			_nodes[sibling].parent = null_node;
+			return;
+		}
+
+		if (_nodes[grandparent].left == parent)
+			_nodes[grandparent].left = sibling;
+		else
+			_nodes[grandparent].right = sibling;
+		_nodes[sibling].parent = grandparent;
+		refit(grandparent);
+	}
+
+	void bvh::refit(int index) {
+		while (index != null_node) {
+			index = balance(index);
+			node& node = _nodes[index];
+			const bvh::node& left = _nodes[node.left];
+			const bvh::node& right = _nodes[node.right];
+			node.min = glm::min(left.min, right.min);
+			node.max = glm::max(left.max, right.max);
+			node.height = 1 + std::max(left.height, right.height);
+			index = node.parent;
+		}
+	}
+
+	// rotates the taller grandchild up when the children of a differ in height by more than one,
+	// returns the node now standing where a was
+	int bvh::balance(int a) {
+		node& node_a = _nodes[a];
+		if (node_a.leaf() || node_a.height < 2)
+			return a;
+
+		const int b = node_a.left;
+		const int c = node_a.right;
+		const int difference = _nodes[c].height - _nodes[b].height;
+		if (std::abs(difference) <= 1)
+			return a;
+
+		// promote the taller child up, its taller child stays under it and the other moves down to a
+		const int up = difference > 0 ? c : b;
+		const int down = difference > 0 ? b : c;
+		node& node_up = _nodes[up];
+		const int f = node_up.left;
+		const int g = node_up.right;
+
+		node_up.left = a;
+		node_up.parent = node_a.parent;
+		node_a.parent = up;
+		if (node_up.parent == null_node)
+			_root = up;
+		else if (_nodes[node_up.parent].left == a)
+			_nodes[node_up.parent].left = up;
+		else
+			_nodes[node_up.parent].right = up;
+
+		const int kept = _nodes[f].height > _nodes[g].height ? f : g;
+		const int moved = kept == f ? g : f;
+		node_up.right = kept;
+		if (difference > 0)
+			node_a.right = moved;
+		else
+			node_a.left = moved;
+		_nodes[moved].parent = a;
+
+		node_a.min = glm::min(_nodes[down].min, _nodes[moved].min);
+		node_a.max = glm::max(_nodes[down].max, _nodes[moved].max);
+		node_a.height = 1 + std::max(_nodes[down].height, _nodes[moved].height);
+		node_up.min = glm::min(node_a.min, _nodes[kept].min);
+		node_up.max = glm::max(node_a.max, _nodes[kept].max);
+		node_up.height = 1 + std::max(node_a.height, _nodes[kept].height);
+		return up;
+	}
+}
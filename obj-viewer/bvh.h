@@ -0,0 +1,128 @@
+#pragma once
+
+#include <vector> // vector
+#include <utility> // pair
+#include <cmath> // isinf
+#include <algorithm> // min max
+#include <glm/vec3.hpp> // vec3
+#include <glm/glm.hpp> // min max
+#include "bounds.h" // bounding_volume frustum containment
+
+namespace obj_viewer {
+
+	// dynamic axis aligned bounding volume hierarchy. leaves keep a box enlarged by a margin, so small
+	// movements change nothing and larger ones reinsert a single leaf. tree rotations keep it balanced
+	class bvh {
+	public:
+		static const int null_node = -1;
+
+		bvh();
+		void clear();
+		int insert(const bounding_volume& box, size_t item);
+		void remove(int proxy);
+		// returns whether the leaf had to be reinserted
+		bool update(int proxy, const bounding_volume& box);
+		size_t item(int proxy) const;
+		int height() const;
+		size_t size() const;
+
+		// visit(item, contained) for every leaf touching the frustum, whole subtrees inside it are not tested further
+		template <typename Visit>
+		void query(const frustum& frustum, Visit visit) const {
+			if (_root == null_node)
+				return;
+			// local, so queries may run from several threads or nest inside a visit
+			std::vector<std::pair<int, bool>> stack;
+			stack.reserve(size_t(_nodes[_root].height) + 1);
+			stack.push_back({ _root, false });
+			while (!stack.empty()) {
+				const int index = stack.back().first;
+				const bool contained = stack.back().second;
+				stack.pop_back();
+				const node& node = _nodes[index];
+				bool inside = contained;
+				if (!inside) {
+					const containment result = frustum.classify(node.min, node.max);
+					if (result == containment::outside)
+						continue;
+					inside = result == containment::inside;
+				}
+				if (node.leaf())
+					visit(node.item, inside);
+				else {
+					stack.push_back({ node.right, inside });
+					stack.push_back({ node.left, inside });
+				}
+			}
+		}
+
+		// visit(item, max_distance) for every leaf the ray enters before max_distance, it returns the new max_distance
+		template <typename Visit>
+		void raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance, Visit visit) const {
+			if (_root == null_node)
+				return;
+			const glm::vec3 inverse = 1.0f / direction;
+			std::vector<int> stack;
+			stack.reserve(size_t(_nodes[_root].height) + 1);
+			stack.push_back(_root);
+			while (!stack.empty()) {
+				const int index = stack.back();
+				stack.pop_back();
+				const node& node = _nodes[index];
+				float enter = 0.0f;
+				float leave = max_distance;
+				if (!clip_ray(origin, inverse, node.min, node.max, enter, leave))
+					continue;
+				if (node.leaf())
+					max_distance = visit(node.item, max_distance);
+				else {
+					stack.push_back(node.right);
+					stack.push_back(node.left);
+				}
+			}
+		}
+
+	private:
+		class node {
+		public:
+			glm::vec3 min;
+			glm::vec3 max;
+			size_t item;
+			int parent;
+			int left;
+			int right;
+			int height;
+
+			bool leaf() const { return left == null_node; }
+		};
+
+		std::vector<node> _nodes;
+		int _root;
+		int _free;
+		size_t _leaves;
+
+		// narrows [enter, leave] to where the ray is inside the box. an axis the ray runs parallel to has an
+		// infinite inverse and would give 0 * inf = NaN on a face, so it either keeps the whole ray or misses
+		static bool clip_ray(const glm::vec3& origin, const glm::vec3& inverse, const glm::vec3& min, const glm::vec3& max, float& enter, float& leave) {
+			for (int axis = 0; axis < 3; ++axis) {
+				if (std::isinf(inverse[axis])) {
+					if (origin[axis] < min[axis] || origin[axis] > max[axis])
+						return false;
+					continue;
+				}
+				const float t0 = (min[axis] - origin[axis]) * inverse[axis];
+				const float t1 = (max[axis] - origin[axis]) * inverse[axis];
+				enter = std::max(enter, std::min(t0, t1));
+				leave = std::min(leave, std::max(t0, t1));
+			}
+			return enter <= leave;
+		}
+
+		int allocate();
+		void release(int index);
+		void insert_leaf(int leaf);
+		void remove_leaf(int leaf);
+		int balance(int index);
+		void refit(int index);
+	};
+}
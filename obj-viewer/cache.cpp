@@ -0,0 +1,165 @@
+#include "cache.h"
+
+#include <cstdio> // fopen fwrite
+#include <cstring> // memcpy
+#include <filesystem> // path relative
+#include "mapped_file.h" // mapped_file
+
+namespace obj_viewer {
+
+	static const char cache_magic[4] = { 'O', 'B', 'J', 'C' };
+	static const std::uint32_t cache_version = 2;
+
+	class cache_header {
+	public:
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t mesh_count;
+		std::uint32_t reserved;
+	};
+
+	class cache_mesh_header {
+	public:
+		std::uint32_t vertex_count;
+		std::uint32_t index_count;
+		std::uint32_t index_size;
+		std::uint32_t name_length;
+		std::uint32_t texture_length;
+		float offset[3];
+		float scale[3];
+		float diffuse[3];
+		float specular[3];
+		float ambient[3];
+		float shininess;
+	};
+
+	static_assert(sizeof(quantized_vertex) == 16, "cached vertices are uploaded as they are stored");
+
+	static size_t align(size_t size) {
+		return (size + 7) & ~size_t(7);
+	}
+
+	cached_mesh process_mesh(mesh_data&& mesh) {
+		cached_mesh result;
+		result.material = mesh.material;
+		result.texture_filepath = mesh.texture_filepath;
+
+		repair(mesh.vertices);
+		result.indices = weld(mesh.vertices);
+		optimize_vertex_cache(result.indices, mesh.vertices.positions.size());
+		optimize_vertex_fetch(mesh.vertices, result.indices);
+		result.vertices = quantize(mesh.vertices);
+		return result;
+	}
+
+	bool write_cache(const std::string& filepath, const std::vector<cached_mesh>& meshes) {
+		const std::filesystem::path directory = std::filesystem::absolute(filepath).parent_path();
+		std::vector<unsigned char> bytes;
+		auto append = [&bytes](const void* data, size_t size) {
+			const unsigned char* begin = static_cast<const unsigned char*>(data);
+			bytes.insert(bytes.end(), begin, begin + size);
+		};
+
+		cache_header header = {};
+		memcpy(header.magic, cache_magic, sizeof(cache_magic));
+		header.version = cache_version;
+		header.mesh_count = std::uint32_t(meshes.size());
+		append(&header, sizeof(header));
+
+		for (const cached_mesh& mesh : meshes) {
+			std::string texture;
+			if (!mesh.texture_filepath.empty())
+				texture = std::filesystem::absolute(mesh.texture_filepath).lexically_relative(directory).generic_string();
+
+			const size_t vertex_count = mesh.vertices.size();
+			cache_mesh_header mesh_header = {};
+			mesh_header.vertex_count = std::uint32_t(vertex_count);
+			mesh_header.index_count = std::uint32_t(mesh.indices.size());
+			mesh_header.index_size = vertex_count <= 0xffff ? 2 : 4;
+			mesh_header.name_length = std::uint32_t(mesh.material.name.size());
+			mesh_header.texture_length = std::uint32_t(texture.size());
+			memcpy(mesh_header.offset, &mesh.vertices.offset, sizeof(mesh_header.offset));
+			memcpy(mesh_header.scale, &mesh.vertices.scale, sizeof(mesh_header.scale));
+			memcpy(mesh_header.diffuse, &mesh.material.diffuse, sizeof(mesh_header.diffuse));
+			memcpy(mesh_header.specular, &mesh.material.specular, sizeof(mesh_header.specular));
+			memcpy(mesh_header.ambient, &mesh.material.ambient, sizeof(mesh_header.ambient));
+			mesh_header.shininess = mesh.material.shininess;
+
+			append(&mesh_header, sizeof(mesh_header));
+			append(mesh.material.name.data(), mesh.material.name.size());
+			append(texture.data(), texture.size());
+			bytes.resize(align(bytes.size()), 0);
+
+			append(mesh.vertices.packed.data(), vertex_count * sizeof(quantized_vertex));
+			if (mesh_header.index_size == 2) {
+				for (std::uint32_t index : mesh.indices) {
+					const std::uint16_t short_index = std::uint16_t(index);
+					append(&short_index, sizeof(short_index));
+				}
+			}
+			else {
+				append(mesh.indices.data(), mesh.indices.size() * sizeof(std::uint32_t));
+			}
+			bytes.resize(align(bytes.size()), 0);
+		}
+
+		FILE* fp = fopen(filepath.c_str(), "wb");
+		if (fp == NULL)
+			return false;
+		const size_t written = fwrite(bytes.data(), 1, bytes.size(), fp);
+		fclose(fp);
+		return written == bytes.size();
+	}
+
+	bool read_cache(const mapped_file& file, const std::string& filepath, std::vector<mapped_mesh>& meshes) {
+		if (file.size() < sizeof(cache_header))
+			return false;
+
+		const unsigned char* data = file.data();
+		const unsigned char* end = data + file.size();
+		const cache_header* header = reinterpret_cast<const cache_header*>(data);
+		if (memcmp(header->magic, cache_magic, sizeof(cache_magic)) != 0 || header->version != cache_version)
+			return false;
+
+		const std::string directory = filepath.substr(0, filepath.find_last_of("/\\") + 1);
+		data += sizeof(cache_header);
+
+		for (std::uint32_t m = 0; m < header->mesh_count; ++m) {
+			if (end - data < std::ptrdiff_t(sizeof(cache_mesh_header)))
+				return false;
+			const cache_mesh_header* mesh_header = reinterpret_cast<const cache_mesh_header*>(data);
+			const size_t vertex_count = mesh_header->vertex_count;
+			const size_t strings = sizeof(cache_mesh_header) + mesh_header->name_length + mesh_header->texture_length;
+			const size_t arrays = vertex_count * sizeof(quantized_vertex) + size_t(mesh_header->index_count) * mesh_header->index_size;
+			if ((mesh_header->index_size != 2 && mesh_header->index_size != 4) || size_t(end - data) < align(strings) + arrays)
+				return false;
+
+			const char* name = reinterpret_cast<const char*>(data + sizeof(cache_mesh_header));
+			const char* texture = name + mesh_header->name_length;
+			data += align(strings);
+
+			mapped_mesh mesh;
+			memcpy(&mesh.offset, mesh_header->offset, sizeof(mesh_header->offset));
+			memcpy(&mesh.scale, mesh_header->scale, sizeof(mesh_header->scale));
+			mesh.vertices = reinterpret_cast<const quantized_vertex*>(data);
+			mesh.vertex_count = vertex_count;
+			data += vertex_count * sizeof(quantized_vertex);
+
+			mesh.indices = data;
+			mesh.index_count = mesh_header->index_count;
+			mesh.index_size = mesh_header->index_size;
+			data += align(size_t(mesh_header->index_count) * mesh_header->index_size);
+
+			mesh.material.name.assign(name, mesh_header->name_length);
+			memcpy(&mesh.material.diffuse, mesh_header->diffuse, sizeof(mesh_header->diffuse));
+			memcpy(&mesh.material.specular, mesh_header->specular, sizeof(mesh_header->specular));
+			memcpy(&mesh.material.ambient, mesh_header->ambient, sizeof(mesh_header->ambient));
+			mesh.material.shininess = mesh_header->shininess;
+			if (mesh_header->texture_length > 0)
+				mesh.texture_filepath = directory + std::string(texture, mesh_header->texture_length);
+
+			meshes.push_back(std::move(mesh));
+		}
+		return true;
+	}
+}
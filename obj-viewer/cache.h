@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include <cstdint> // uint32_t
+#include <glm/vec3.hpp> // vec3
+#include "mesh_data.h" // mesh_data material
+#include "geometry.h" // quantized_vertices quantized_vertex
+#include "mapped_file.h" // mapped_file
+
+namespace obj_viewer {
+
+	class cached_mesh {
+	public:
+		material material;
+		std::string texture_filepath;
+		quantized_vertices vertices;
+		std::vector<std::uint32_t> indices;
+	};
+
+	// one mesh of an open cache file, pointing straight into the mapping
+	class mapped_mesh {
+	public:
+		material material;
+		std::string texture_filepath;
+		glm::vec3 offset;
+		glm::vec3 scale;
+		const quantized_vertex* vertices;
+		size_t vertex_count;
+		const void* indices;
+		size_t index_count;
+		size_t index_size;
+	};
+
+	cached_mesh process_mesh(mesh_data&& mesh);
+	bool write_cache(const std::string& filepath, const std::vector<cached_mesh>& meshes);
+	bool read_cache(const mapped_file& file, const std::string& filepath, std::vector<mapped_mesh>& meshes);
+}
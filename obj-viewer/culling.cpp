@@ -0,0 +1,263 @@
+#include "culling.h"
+
+#include <cmath> // abs
+#include <algorithm> // sort fill count
+#include <glm/glm.hpp> // length
+#include "bounds.h" // bounding_volume
+
+#if defined(__AVX__)
+#include <immintrin.h> // _mm256_*
+#define CULL_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h> // _mm_*
+#define CULL_SSE
+#endif
+
+namespace obj_viewer {
+
+	cull_stats::cull_stats() : objects_visible(0), objects_culled(0), visible(0), culled(0), occluded(0) {
+		// nop
+	}
+
+	void frustum_culler::box_array::clear() {
+		center_x.clear();
+		center_y.clear();
+		center_z.clear();
+		extent_x.clear();
+		extent_y.clear();
+		extent_z.clear();
+	}
+
+	void frustum_culler::box_array::push_back(const glm::vec3& center, const glm::vec3& extent) {
+		center_x.push_back(center.x);
+		center_y.push_back(center.y);
+		center_z.push_back(center.z);
+		extent_x.push_back(extent.x);
+		extent_y.push_back(extent.y);
+		extent_z.push_back(extent.z);
+	}
+
+	size_t frustum_culler::box_array::size() const {
+		return center_x.size();
+	}
+
+	frustum_culler::frustum_culler() : _view_projection(1.0f), _version(~size_t(0)), _object_count(0) {
+		// nop
+	}
+
+	void frustum_culler::begin_frame(const std::vector<std::unique_ptr<object>>& objs) {
+		if (_version != scene_version() || _object_count != objs.size())
+			rebuild(objs);
+		else {
+			for (const object* obj : take_moved_objects()) {
+				const auto found = _indices.find(obj);
+				if (found == _indices.end())
+					continue;
+				const glm::mat4 model = obj->model();
+				refit_meshes(found->second, model);
+				if (_proxies[found->second] != bvh::null_node)
+					_tree.update(_proxies[found->second], _local_bounds[found->second].transformed(model));
+			}
+		}
+		stats = cull_stats();
+	}
+
+	const std::vector<size_t>& frustum_culler::cull_objects(const glm::mat4& view_projection) {
+		_view_projection = view_projection;
+		_visible_objects.clear();
+		_tree.query(frustum(view_projection), [this](size_t object, bool contained) {
+			_visible_objects.push_back(object);
+			_contained[object] = contained ? 1 : 0;
+		});
+		std::sort(_visible_objects.begin(), _visible_objects.end());
+
+		stats.objects_visible = _visible_objects.size();
+		stats.objects_culled = _object_count - _visible_objects.size();
+		return _visible_objects;
+	}
+
+	const bvh& frustum_culler::hierarchy() const {
+		return _tree;
+	}
+
+	// mesh boxes are gathered again, but objects that stay keep their leaves and are only refitted
+	void frustum_culler::rebuild(const std::vector<std::unique_ptr<object>>& objs) {
+		_version = scene_version();
+		_object_count = objs.size();
+		_local.clear();
+		_first.clear();
+		_local_bounds.clear();
+		std::unordered_map<const object*, size_t> previous;
+		previous.swap(_indices);
+		std::vector<int> previous_proxies;
+		previous_proxies.swap(_proxies);
+		take_moved_objects();
+
+		for (size_t o = 0; o < objs.size(); ++o) {
+			const auto& obj = objs[o];
+			_first.push_back(_local.size());
+			bounding_volume local;
+			for (const mesh& mesh : *obj->meshes) {
+				// an instanced mesh is culled as a whole by the box around all of its copies
+				bounding_volume bounds;
+				if (obj->instances.empty())
+					bounds = mesh.bounds;
+				for (const glm::mat4& instance : obj->instances)
+					bounds.merge(mesh.bounds.transformed(instance));
+
+				// an empty box gets a negative extent and fails every plane
+				const glm::vec3 extent = bounds.empty() ? glm::vec3(-1e30f) : (bounds.max - bounds.min) * 0.5f;
+				_local.push_back((bounds.min + bounds.max) * 0.5f, extent);
+				local.merge(bounds);
+			}
+
+			_local_bounds.push_back(local);
+			_indices[obj.get()] = o;
+			int proxy = bvh::null_node;
+			const auto found = previous.find(obj.get());
+			if (found != previous.end()) {
+				proxy = previous_proxies[found->second];
+				// a leaf keeps its item, so an object that moved in the list is inserted again
+				if (proxy != bvh::null_node && (local.empty() || found->second != o)) {
+					_tree.remove(proxy);
+					proxy = bvh::null_node;
+				}
+				previous.erase(found);
+			}
+			if (proxy != bvh::null_node)
+				_tree.update(proxy, local.transformed(obj->model()));
+			else if (!local.empty())
+				proxy = _tree.insert(local.transformed(obj->model()), o);
+			_proxies.push_back(proxy);
+		}
+		for (const auto& gone : previous) {
+			if (previous_proxies[gone.second] != bvh::null_node)
+				_tree.remove(previous_proxies[gone.second]);
+		}
+		_first.push_back(_local.size());
+		_world = _local;
+		for (size_t o = 0; o < objs.size(); ++o)
+			refit_meshes(o, objs[o]->model());
+		_visible.resize(_local.size());
+		_contained.assign(objs.size(), 0);
+	}
+
+	// the world box of a model space box is centered on the moved center, with the extent
+	// spread over the axes by the absolute rotation and scale
+	void frustum_culler::refit_meshes(size_t object, const glm::mat4& model) {
+		const glm::mat4 spread = glm::mat4(glm::abs(model[0]), glm::abs(model[1]), glm::abs(model[2]), glm::vec4(0.0f));
+		for (size_t i = _first[object]; i < _first[object + 1]; ++i) {
+			const glm::vec4 center = model * glm::vec4(_local.center_x[i], _local.center_y[i], _local.center_z[i], 1.0f);
+			const glm::vec4 extent = spread * glm::vec4(_local.extent_x[i], _local.extent_y[i], _local.extent_z[i], 0.0f);
+			const bool empty = _local.extent_x[i] < 0.0f;
+			_world.center_x[i] = center.x;
+			_world.center_y[i] = center.y;
+			_world.center_z[i] = center.z;
+			_world.extent_x[i] = empty ? -1e30f : extent.x;
+			_world.extent_y[i] = empty ? -1e30f : extent.y;
+			_world.extent_z[i] = empty ? -1e30f : extent.z;
+		}
+	}
+
+	const unsigned char* frustum_culler::visible(size_t object) const {
+		return _visible.data() + _first[object];
+	}
+
+	void frustum_culler::cull_meshes() {
+		std::fill(_visible.begin(), _visible.end(), 0);
+		_runs.clear();
+		for (const size_t object : _visible_objects) {
+			const size_t first = _first[object], last = _first[object + 1];
+			if (_contained[object]) {
+				std::fill(_visible.begin() + first, _visible.begin() + last, 1);
+				continue;
+			}
+			// objects next to each other in the scene keep their meshes in one run
+			if (!_runs.empty() && _runs.back().second == first)
+				_runs.back().second = last;
+			else if (first != last)
+				_runs.push_back({ first, last });
+		}
+
+		const frustum frustum(_view_projection);
+		const float* cx = _world.center_x.data();
+		const float* cy = _world.center_y.data();
+		const float* cz = _world.center_z.data();
+		const float* ex = _world.extent_x.data();
+		const float* ey = _world.extent_y.data();
+		const float* ez = _world.extent_z.data();
+		unsigned char* visible = _visible.data();
+
+		// a box is outside a plane when its center is farther behind it than its projected extent
+#if defined(CULL_AVX)
+		__m256 normal[6][3];
+		__m256 absolute[6][3];
+		__m256 distance[6];
+		for (int p = 0; p < 6; ++p) {
+			for (int c = 0; c < 3; ++c) {
+				normal[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+				absolute[p][c] = _mm256_set1_ps(std::abs(frustum.planes[p][c]));
+			}
+			distance[p] = _mm256_set1_ps(frustum.planes[p].w);
+		}
+		const __m256 zero = _mm256_setzero_ps();
+#elif defined(CULL_SSE)
+		__m128 normal[6][3];
+		__m128 absolute[6][3];
+		__m128 distance[6];
+		for (int p = 0; p < 6; ++p) {
+			for (int c = 0; c < 3; ++c) {
+				normal[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+				absolute[p][c] = _mm_set1_ps(std::abs(frustum.planes[p][c]));
+			}
+			distance[p] = _mm_set1_ps(frustum.planes[p].w);
+		}
+		const __m128 zero = _mm_setzero_ps();
+#endif
+		for (const auto& run : _runs) {
+			size_t i = run.first;
+#if defined(CULL_AVX)
+			for (; i + 8 <= run.second; i += 8) {
+				const __m256 x = _mm256_loadu_ps(cx + i), y = _mm256_loadu_ps(cy + i), z = _mm256_loadu_ps(cz + i);
+				const __m256 sx = _mm256_loadu_ps(ex + i), sy = _mm256_loadu_ps(ey + i), sz = _mm256_loadu_ps(ez + i);
+				__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+				for (int p = 0; p < 6; ++p) {
+					const __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normal[p][0], x), _mm256_mul_ps(normal[p][1], y)), _mm256_add_ps(_mm256_mul_ps(normal[p][2], z), distance[p]));
+					const __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absolute[p][0], sx), _mm256_mul_ps(absolute[p][1], sy)), _mm256_mul_ps(absolute[p][2], sz));
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_GE_OQ));
+				}
+				const int mask = _mm256_movemask_ps(inside);
+				for (int lane = 0; lane < 8; ++lane)
+					visible[i + lane] = (mask >> lane) & 1;
+			}
+#elif defined(CULL_SSE)
+			for (; i + 4 <= run.second; i += 4) {
+				const __m128 x = _mm_loadu_ps(cx + i), y = _mm_loadu_ps(cy + i), z = _mm_loadu_ps(cz + i);
+				const __m128 sx = _mm_loadu_ps(ex + i), sy = _mm_loadu_ps(ey + i), sz = _mm_loadu_ps(ez + i);
+				__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				for (int p = 0; p < 6; ++p) {
+					const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normal[p][0], x), _mm_mul_ps(normal[p][1], y)), _mm_add_ps(_mm_mul_ps(normal[p][2], z), distance[p]));
+					const __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absolute[p][0], sx), _mm_mul_ps(absolute[p][1], sy)), _mm_mul_ps(absolute[p][2], sz));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+				}
+				const int mask = _mm_movemask_ps(inside);
+				for (int lane = 0; lane < 4; ++lane)
+					visible[i + lane] = (mask >> lane) & 1;
+			}
+#endif
+			for (; i < run.second; ++i) {
+				bool inside = true;
+				for (const glm::vec4& plane : frustum.planes) {
+					const float d = plane.x * cx[i] + plane.y * cy[i] + plane.z * cz[i] + plane.w;
+					const float r = std::abs(plane.x) * ex[i] + std::abs(plane.y) * ey[i] + std::abs(plane.z) * ez[i];
+					inside = inside && d + r >= 0.0f;
+				}
+				visible[i] = inside ? 1 : 0;
+			}
+		}
+
+		const size_t count = _visible.size();
+		stats.visible = size_t(std::count(_visible.begin(), _visible.end(), 1));
+		stats.culled = count - stats.visible;
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector> // vector
+#include <utility> // pair
+#include <memory> // unique_ptr
+#include <unordered_map> // unordered_map
+#include <glm/vec4.hpp> // vec4
+#include <glm/mat4x4.hpp> // mat4
+#include "object.h" // object
+#include "bounds.h" // bounding_volume
+#include "bvh.h" // bvh
+
+namespace obj_viewer {
+
+	class cull_stats {
+	public:
+		size_t objects_visible;
+		size_t objects_culled;
+		size_t visible;
+		size_t culled;
+		// visible meshes hidden by occlusion culling, filled in by the engine
+		size_t occluded;
+
+		cull_stats();
+	};
+
+	// objects are culled through a bvh over their world boxes, then the meshes of every object the view cuts
+	// are culled together against world boxes kept in structure-of-arrays form and tested several at a time.
+	// the world boxes of an object's meshes are refitted from their model space boxes only when it moves
+	class frustum_culler {
+	public:
+		cull_stats stats;
+
+		frustum_culler();
+		// rebuilds everything when the scene changed, otherwise refits the objects that moved, and resets the stats
+		void begin_frame(const std::vector<std::unique_ptr<object>>& objs);
+		// indices of the objects touching the view in ascending order, view_projection maps world space to clip space
+		const std::vector<size_t>& cull_objects(const glm::mat4& view_projection);
+		// tests the meshes of the objects cull_objects found against the same view
+		void cull_meshes();
+		// one visibility flag per mesh of the object, all clear when cull_objects did not find it
+		const unsigned char* visible(size_t object) const;
+		// world space object boxes, items are object indices
+		const bvh& hierarchy() const;
+
+	private:
+		class box_array {
+		public:
+			std::vector<float> center_x;
+			std::vector<float> center_y;
+			std::vector<float> center_z;
+			std::vector<float> extent_x;
+			std::vector<float> extent_y;
+			std::vector<float> extent_z;
+
+			void clear();
+			void push_back(const glm::vec3& center, const glm::vec3& extent);
+			size_t size() const;
+		};
+
+		box_array _local;
+		box_array _world;
+		std::vector<size_t> _first;
+		std::vector<unsigned char> _visible;
+		std::vector<bounding_volume> _local_bounds;
+		std::vector<int> _proxies;
+		std::unordered_map<const object*, size_t> _indices;
+		bvh _tree;
+		std::vector<size_t> _visible_objects;
+		std::vector<unsigned char> _contained;
+		// contiguous mesh ranges of the objects the view cuts
+		std::vector<std::pair<size_t, size_t>> _runs;
+		glm::mat4 _view_projection;
+		size_t _version;
+		size_t _object_count;
+
+		void rebuild(const std::vector<std::unique_ptr<object>>& objs);
+		void refit_meshes(size_t object, const glm::mat4& model);
+	};
+}
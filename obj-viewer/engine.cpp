@@ -11,11 +11,18 @@
 #include <glm/gtx/quaternion.hpp> // quat
 
 #include <iostream> // cout
-#include <cmath> // sin cos
-
-#define BUFFER_OFFSET(offset) ((GLvoid*)(offset))
-
-GLuint InitShader(const char* vShaderFile, const char* fShaderFiie);
+#include <cmath> // sin cos tan
+#include <algorithm> // max stable_sort fill
+#include <chrono> // steady_clock
+#include <numeric> // iota
+#include "registry.h" // asset_registry
+#include "upload.h" // upload_queue
+#include "vertex_format.h" // vertex_layout_defines set_vertex_layout_constants instance_transform
+#include "indirect.h" // indirect_renderer object_view
+#include "culling.h" // frustum_culler cull_stats
+#include "occlusion.h" // occlusion_buffer occluder
+
+GLuint InitShader(const char* vShaderFile, const char* fShaderFiie, const char* defines);
 
 namespace obj_viewer {
 
@@ -23,6 +30,22 @@ namespace obj_viewer {
 	static std::unique_ptr<glm::vec3> last_cursor_vec3;
 	static glm::quat camera_orientation = { 1.0f, 0.0f, 0.0f, 0.0f };
 	static glm::vec3 light_position = { 100.0f, 100.0f, 100.0f };
+	static const GLfloat field_of_view = 50.0f;
+	static glm::mat4 projection_matrix(1.0f);
+	static frustum_culler culler;
+	static occlusion_buffer* occlusion = NULL;
+	static size_t occluded_meshes = 0;
+
+	static int benchmark_frames = 0;
+	static int benchmark_frame = 0;
+	static double benchmark_cpu_ms = 0.0;
+	static double benchmark_gpu_ms = 0.0;
+	static size_t benchmark_objects = 0;
+	static size_t benchmark_visible = 0;
+	static size_t benchmark_culled = 0;
+	static size_t benchmark_occluded = 0;
+	static GLuint benchmark_queries[2];
+	static indirect_renderer* indirect_scene = NULL;
 
 	static void display_callback();
 	static void idle_callback();
@@ -33,7 +56,66 @@ namespace obj_viewer {
 	static void wheel_callback(int wheel, int direction, int x, int y);
 	static std::unique_ptr<glm::vec3> point_to_trackball_vec3(int x, int y);
 
-	engine::engine() : _model_view_loc(0), _projection_loc(0) {
+	class draw_call {
+	public:
+		unsigned variant;
+		texture_binding binding;
+		const mesh* source;
+
+		bool operator<(const draw_call& other) const {
+			if (variant != other.variant)
+				return variant < other.variant;
+			return binding < other.binding;
+		}
+	};
+
+	shader_program::shader_program() : program(0) {
+		// nop
+	}
+
+	void shader_program::load(const char* vertex_shader, const char* fragment_shader, unsigned variant) {
+		std::string defines = (variant & variant_indirect) ? "#version 430 compatibility\n#define INDIRECT\n" : "";
+		defines += vertex_layout_defines();
+		if (variant & variant_normals)
+			defines += "#define HAS_NORMALS\n";
+		if (variant & variant_texture)
+			defines += "#define HAS_TEXTURE\n";
+		program = InitShader(vertex_shader, fragment_shader, defines.c_str());
+
+		model_view_loc = glGetUniformLocation(program, "ModelView");
+		model_loc = glGetUniformLocation(program, "Model");
+		view_loc = glGetUniformLocation(program, "View");
+		projection_loc = glGetUniformLocation(program, "Projection");
+		light_loc = glGetUniformLocation(program, "lightPosition");
+
+		diffuse_loc = glGetUniformLocation(program, "diffuse");
+		specular_loc = glGetUniformLocation(program, "specular");
+		ambient_loc = glGetUniformLocation(program, "ambient");
+		shininess_loc = glGetUniformLocation(program, "shininess");
+		position_offset_loc = glGetUniformLocation(program, "positionOffset");
+		position_scale_loc = glGetUniformLocation(program, "positionScale");
+		texture_offset_loc = glGetUniformLocation(program, "textureOffset");
+		texture_scale_loc = glGetUniformLocation(program, "textureScale");
+		texture_loc = glGetUniformLocation(program, "textureSampler");
+		texture_array_loc = glGetUniformLocation(program, "textureArraySampler");
+		texture_layer_loc = glGetUniformLocation(program, "textureLayer");
+		draw_offset_loc = glGetUniformLocation(program, "drawOffset");
+
+		glUniform3fv(light_loc, 1, glm::value_ptr(light_position));
+		glUniform1i(texture_loc, 0);
+		glUniform1i(texture_array_loc, 1);
+	}
+
+	unsigned mesh_variant(const mesh& mesh) {
+		unsigned variant = 0;
+		if (mesh.streams & stream_normals)
+			variant |= variant_normals;
+		if ((mesh.streams & stream_texture_coordinates) && !asset_registry::instance().is_white_texture(mesh.texture_id))
+			variant |= variant_texture;
+		return variant;
+	}
+
+	engine::engine() : _indirect(false), _culling(true), _occlusion(false) {
 		// nop
 	}
 
@@ -49,6 +131,8 @@ namespace obj_viewer {
 		glutInitWindowSize(width, height);
 		glutCreateWindow(title.c_str());
 		glewInit();
+		// lets the benchmark leave the main loop and return from run
+		glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_GLUTMAINLOOP_RETURNS);
 
 		glutDisplayFunc(display_callback);
 		glutIdleFunc(idle_callback);
@@ -66,22 +150,17 @@ namespace obj_viewer {
 		glGenBuffers(1, &buffer);
 		glBindBuffer(GL_ARRAY_BUFFER, buffer);
 
-		GLuint program = InitShader("vshader.glsl", "fshader.glsl");
-		glUseProgram(program);
-
-		_model_view_loc = glGetUniformLocation(program, "ModelView");
-		_model_loc = glGetUniformLocation(program, "Model");
-		_view_loc = glGetUniformLocation(program, "View");
-		_projection_loc = glGetUniformLocation(program, "Projection");
-		_light_loc = glGetUniformLocation(program, "lightPosition");
-
-		_diffuse_loc = glGetUniformLocation(program, "diffuse");
-		_specular_loc = glGetUniformLocation(program, "specular");
-		_ambient_loc = glGetUniformLocation(program, "ambient");
-		_shininess_loc = glGetUniformLocation(program, "shininess");
-		_texture_loc = glGetUniformLocation(program, "textureSampler");
+		if (_indirect && !indirect_renderer::supported()) {
+			std::cerr << "Multi-draw indirect is not supported, drawing meshes one by one\n";
+			_indirect = false;
+		}
+		_programs.resize(variant_count);
+		for (unsigned variant = 0; variant < variant_count; ++variant) {
+			if (!(variant & variant_indirect) || _indirect)
+				_programs[variant].load("vshader.glsl", "fshader.glsl", variant);
+		}
 
-		glUniform3fv(_light_loc, 1, glm::value_ptr(light_position));
+		set_vertex_layout_constants();
 
 		//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 		glClearColor(1.0, 1.0, 1.0, 1.0);
@@ -90,6 +169,7 @@ namespace obj_viewer {
 	}
 
 	void engine::add_object(std::unique_ptr<object> obj) {
+		_reloader.track(*obj);
 		this->objs.push_back(std::move(obj));
 	}
 
@@ -97,44 +177,86 @@ namespace obj_viewer {
 		glutMainLoop();
 	}
 
-	GLuint engine::model_view_loc() const {
-		return _model_view_loc;
+	void engine::hot_reload() {
+		_reloader.update(glutGet(GLUT_ELAPSED_TIME));
+	}
+
+	void engine::set_culling(bool culling) {
+		_culling = culling;
 	}
 
-	GLuint engine::model_loc() const {
-		return _model_loc;
+	void engine::set_indirect(bool indirect) {
+		_indirect = indirect;
 	}
 
-	GLuint engine::view_loc() const {
-		return _view_loc;
+	bool engine::indirect() const {
+		return _indirect;
 	}
 
-	GLuint engine::projection_loc() const {
-		return _projection_loc;
+	bool engine::culling() const {
+		return _culling;
 	}
 
-	GLuint engine::light_loc() const {
-		return _light_loc;
+	void engine::set_occlusion(bool occlusion) {
+		_occlusion = occlusion;
+		set_occluder_proxies(occlusion);
 	}
 
-	GLuint engine::diffuse_loc() const {
-		return _diffuse_loc;
+	bool engine::occlusion() const {
+		return _occlusion;
 	}
 
-	GLuint engine::specular_loc() const {
-		return _specular_loc;
+	void engine::set_benchmark(int frames) {
+		benchmark_frames = frames;
+		if (frames <= 0 || benchmark_queries[0] != 0)
+			return;
+		if (GLEW_ARB_timer_query)
+			glGenQueries(2, benchmark_queries);
+		else
+			std::cerr << "Timer queries are not supported, the benchmark reports cpu time only\n";
 	}
 
-	GLuint engine::ambient_loc() const {
-		return _ambient_loc;
+	static void finish_benchmark_frame(double cpu_ms) {
+		GLuint& query = benchmark_queries[benchmark_frame % 2];
+		GLuint& previous = benchmark_queries[(benchmark_frame + 1) % 2];
+		const bool timed = benchmark_queries[0] != 0;
+		if (timed && benchmark_frame > 0) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(previous, GL_QUERY_RESULT, &elapsed);
+			benchmark_gpu_ms += elapsed / 1e6;
+		}
+		benchmark_cpu_ms += cpu_ms;
+		benchmark_objects += culler.stats.objects_visible;
+		benchmark_visible += culler.stats.visible;
+		benchmark_culled += culler.stats.culled;
+		benchmark_occluded += occluded_meshes;
+		++benchmark_frame;
+
+		if (benchmark_frame < benchmark_frames)
+			return;
+		std::cout << "benchmark " << benchmark_frames << " frames : cpu " << benchmark_cpu_ms / benchmark_frames << " ms";
+		if (timed) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+			benchmark_gpu_ms += elapsed / 1e6;
+			std::cout << ", gpu " << benchmark_gpu_ms / benchmark_frames << " ms";
+		}
+		std::cout << " per frame, "
+			<< benchmark_objects / benchmark_frames << " visible objects, "
+			<< benchmark_visible / benchmark_frames << " visible " << benchmark_culled / benchmark_frames << " culled "
+			<< benchmark_occluded / benchmark_frames << " occluded meshes\n";
+		benchmark_frames = 0;
+		glutLeaveMainLoop();
 	}
 
-	GLuint engine::shininess_loc() const {
-		return _shininess_loc;
+	const shader_program& engine::program(unsigned variant) const {
+		return _programs[variant];
 	}
 
-	GLuint engine::texture_loc() const {
-		return _texture_loc;
+	cull_stats engine::culling_stats() const {
+		cull_stats stats = culler.stats;
+		stats.occluded = occluded_meshes;
+		return stats;
 	}
 
 	std::pair<int, int> engine::window_size() const {
@@ -143,65 +265,213 @@ namespace obj_viewer {
 		return std::pair<int, int>(width, height);
 	}
 
+	// renders the largest visible meshes into the cpu depth buffer, then hides the visible meshes behind them
+	static void cull_occluded(const engine& engine, const std::vector<size_t>& drawn, const std::vector<object_view>& views, std::vector<unsigned char>& visibility, const std::vector<size_t>& first_flags) {
+		if (occlusion == NULL)
+			occlusion = new occlusion_buffer();
+		const auto window = engine.window_size();
+		occlusion->begin(window.first, window.second);
+
+		std::vector<occluder> occluders;
+		for (size_t i = 0; i < views.size(); ++i) {
+			const object& obj = *engine.objs[drawn[i]];
+			// instanced objects would need their proxies once per copy
+			if (!obj.instances.empty())
+				continue;
+			const glm::mat4 clip = projection_matrix * views[i].model_view;
+			const glm::vec3 scale = *(obj.scale());
+			for (size_t m = 0; m < obj.meshes->size(); ++m) {
+				const mesh& mesh = (*obj.meshes)[m];
+				const std::vector<glm::vec3>* triangles = mesh.occluder_triangles();
+				if (!visibility[first_flags[i] + m] || triangles == NULL)
+					continue;
+				const float depth = std::max(-(views[i].model_view * glm::vec4(mesh.bounds.center, 1.0f)).z, 0.1f);
+				occluders.push_back({ triangles, clip, mesh.bounds.radius * std::max({ scale.x, scale.y, scale.z }) / depth });
+			}
+		}
+		occlusion->render(occluders);
+
+		for (size_t i = 0; i < views.size(); ++i) {
+			const object& obj = *engine.objs[drawn[i]];
+			if (!obj.instances.empty())
+				continue;
+			const glm::mat4 clip = projection_matrix * views[i].model_view;
+			for (size_t m = 0; m < obj.meshes->size(); ++m) {
+				unsigned char& visible = visibility[first_flags[i] + m];
+				const mesh& mesh = (*obj.meshes)[m];
+				if (visible && occlusion->occluded(mesh.bounds.min, mesh.bounds.max, clip)) {
+					visible = 0;
+					++occluded_meshes;
+				}
+			}
+		}
+	}
+
 	static void display_callback() {
+		const auto cpu_start = std::chrono::steady_clock::now();
+		const bool benchmarking = benchmark_frames > 0;
+		if (benchmarking && benchmark_queries[0] != 0)
+			glBeginQuery(GL_TIME_ELAPSED, benchmark_queries[benchmark_frame % 2]);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		const engine& engine = engine::instance();
-		const auto model_view_loc = engine.model_view_loc();
-		const auto model_loc = engine.model_loc();
-		const auto view_loc = engine.view_loc();
-		const auto diffuse_loc = engine.diffuse_loc();
-		const auto specular_loc = engine.specular_loc();
-		const auto ambient_loc = engine.ambient_loc();
-		const auto shininess_loc = engine.shininess_loc();
-		const auto texture_loc = engine.texture_loc();
-
 		const auto camera_origin_position = glm::vec3(0.0f, 0.0f, 4.0f);
 		const auto m_camera_origin_view = glm::lookAt(camera_origin_position, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 		const auto m_camera_rotation = glm::toMat4(camera_orientation);
 		const auto m_view = m_camera_origin_view * m_camera_rotation;
+		const float pixels_per_unit = engine.window_size().second / (2.0f * std::tan(glm::radians(field_of_view) * 0.5f));
+		asset_registry& registry = asset_registry::instance();
+		const upload_queue& uploads = upload_queue::instance();
+		GLuint bound_texture = 0;
+		GLuint bound_array = 0;
+		GLint bound_layers[variant_count];
+		std::fill(bound_layers, bound_layers + variant_count, -2);
+		unsigned bound_variant = variant_count;
+		std::vector<draw_call> draws;
+		std::vector<object_view> views;
+		std::vector<unsigned char> visibility;
+		std::vector<size_t> first_flags;
+		culler.begin_frame(engine.objs);
+
+		std::vector<size_t> every_object;
+		const std::vector<size_t>* drawn = &every_object;
+		if (engine.culling()) {
+			drawn = &culler.cull_objects(projection_matrix * m_view);
+			culler.cull_meshes();
+		}
+		else {
+			every_object.resize(engine.objs.size());
+			std::iota(every_object.begin(), every_object.end(), size_t(0));
+		}
 
-		for (auto& obj : engine.objs) {
-			const auto m_scale = glm::scale(*(obj->scale()));
-			const auto m_translation = glm::translate(glm::mat4(1), *(obj->position()));
-			const auto m_rotation = glm::toMat4(*(obj->orientation()));
-			const auto m_model = m_translation * m_scale * m_rotation;
+		for (const size_t o : *drawn) {
+			const auto& obj = engine.objs[o];
+			const auto m_model = obj->model();
 			const auto m_model_view = m_view * m_model;
 
-			glUniformMatrix4fv(model_view_loc, 1, GL_FALSE, glm::value_ptr(m_model_view));
-			glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(m_model));
-			glUniformMatrix4fv(view_loc, 1, GL_FALSE, glm::value_ptr(m_view));
-
-			for (auto& mesh : obj.get()->meshes) {
+			const glm::vec3 scale = *(obj->scale());
+			const float depth = -(m_model_view * glm::vec4(*(obj->center()), 1.0f)).z;
+			const float diameter = 2.0f * obj->radius() * std::max({ scale.x, scale.y, scale.z });
+			const float pixels = depth > 0.1f ? diameter * pixels_per_unit / depth : 1e6f;
+			const size_t mesh_count = obj->meshes->size();
+			first_flags.push_back(visibility.size());
+			if (engine.culling()) {
+				const unsigned char* visible = culler.visible(o);
+				visibility.insert(visibility.end(), visible, visible + mesh_count);
+			}
+			else
+				visibility.resize(visibility.size() + mesh_count, 1);
+			views.push_back({ m_model, m_model_view, pixels, NULL });
+		}
+		for (size_t i = 0; i < views.size(); ++i)
+			views[i].visible = visibility.data() + first_flags[i];
+		occluded_meshes = 0;
+		if (engine.occlusion())
+			cull_occluded(engine, *drawn, views, visibility, first_flags);
+
+		const size_t direct_count = engine.indirect() ? 0 : views.size();
+		for (size_t i = 0; i < direct_count; ++i) {
+			const auto& obj = engine.objs[(*drawn)[i]];
+			const auto& m_model = views[i].model;
+			const auto& m_model_view = views[i].model_view;
+			const unsigned char* visible = views[i].visible;
+			const glm::vec3 scale = *(obj->scale());
+			const std::vector<mesh>& meshes = *obj->meshes;
+
+			draws.clear();
+			for (size_t m = 0; m < meshes.size(); ++m) {
+				const mesh& mesh = meshes[m];
+				if (!visible[m] || !uploads.ready(mesh.upload_ticket))
+					continue;
+				const unsigned variant = mesh_variant(mesh);
+				// texture detail follows the mesh's own bounding sphere rather than the whole object
+				const float mesh_depth = -(m_model_view * glm::vec4(mesh.bounds.center, 1.0f)).z;
+				const float mesh_diameter = 2.0f * mesh.bounds.radius * std::max({ scale.x, scale.y, scale.z });
+				const float mesh_pixels = mesh_depth > 0.1f ? mesh_diameter * pixels_per_unit / mesh_depth : 1e6f;
+				const texture_binding binding = (variant & variant_texture) ? registry.request_texture(mesh.texture_id, mesh_pixels) : texture_binding(0, -1);
+				draws.push_back({ variant, binding, &mesh });
+			}
+			std::stable_sort(draws.begin(), draws.end());
+
+			unsigned object_variants = 0;
+			for (const auto& draw : draws) {
+				const auto& mesh = *draw.source;
+				const texture_binding& binding = draw.binding;
+				const shader_program& program = engine.program(draw.variant);
+				if (draw.variant != bound_variant) {
+					glUseProgram(program.program);
+					bound_variant = draw.variant;
+				}
+				if (!(object_variants & (1u << draw.variant))) {
+					glUniformMatrix4fv(program.model_view_loc, 1, GL_FALSE, glm::value_ptr(m_model_view));
+					glUniformMatrix4fv(program.model_loc, 1, GL_FALSE, glm::value_ptr(m_model));
+					glUniformMatrix4fv(program.view_loc, 1, GL_FALSE, glm::value_ptr(m_view));
+					object_variants |= 1u << draw.variant;
+				}
 				glBindVertexArray(mesh.vao);
 
-				glEnableVertexAttribArray(0);
-				glBindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer);
-				glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-				glEnableVertexAttribArray(1);
-				glBindBuffer(GL_ARRAY_BUFFER, mesh.uv_buffer);
-				glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-				glEnableVertexAttribArray(2);
-				glBindBuffer(GL_ARRAY_BUFFER, mesh.normal_buffer);
-				glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-				glUniformMatrix4fv(model_view_loc, 1, GL_FALSE, glm::value_ptr(m_model_view));
-
-				glUniform3fv(diffuse_loc, 1, glm::value_ptr(mesh.material.diffuse));
-				glUniform3fv(specular_loc, 1, glm::value_ptr(mesh.material.specular));
-				glUniform3fv(ambient_loc, 1, glm::value_ptr(mesh.material.ambient));
-				glUniform1f(shininess_loc, mesh.material.shininess);
-
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, mesh.texture_id);
-				glUniform1i(texture_loc, 0);
-
-				glDrawArrays(GL_TRIANGLES, 0, mesh.vertices.positions.size());
+				glUniform3fv(program.diffuse_loc, 1, glm::value_ptr(mesh.material.diffuse));
+				glUniform3fv(program.specular_loc, 1, glm::value_ptr(mesh.material.specular));
+				glUniform3fv(program.ambient_loc, 1, glm::value_ptr(mesh.material.ambient));
+				glUniform1f(program.shininess_loc, mesh.material.shininess);
+				glUniform3fv(program.position_offset_loc, 1, glm::value_ptr(mesh.position_offset));
+				glUniform3fv(program.position_scale_loc, 1, glm::value_ptr(mesh.position_scale));
+				glUniform2fv(program.texture_offset_loc, 1, glm::value_ptr(mesh.texture_offset));
+				glUniform2fv(program.texture_scale_loc, 1, glm::value_ptr(mesh.texture_scale));
+
+				if (draw.variant & variant_texture) {
+					if (binding.layer < 0 && binding.texture_id != bound_texture) {
+						glActiveTexture(GL_TEXTURE0);
+						glBindTexture(GL_TEXTURE_2D, binding.texture_id);
+						bound_texture = binding.texture_id;
+					}
+					else if (binding.layer >= 0 && binding.texture_id != bound_array) {
+						glActiveTexture(GL_TEXTURE1);
+						glBindTexture(GL_TEXTURE_2D_ARRAY, binding.texture_id);
+						bound_array = binding.texture_id;
+					}
+					if (binding.layer != bound_layers[draw.variant]) {
+						glUniform1i(program.texture_layer_loc, binding.layer);
+						bound_layers[draw.variant] = binding.layer;
+					}
+				}
+
+				if (obj->instances.empty()) {
+					if (mesh.index_buffer != 0)
+						glDrawElements(GL_TRIANGLES, GLsizei(mesh.index_count), GL_UNSIGNED_INT, 0);
+					else
+						glDrawArrays(GL_TRIANGLES, 0, GLsizei(mesh.vertex_count));
+				}
+				else {
+					// the mesh may be shared with uninstanced objects, so the instance attributes stay off afterwards
+					glBindBuffer(GL_ARRAY_BUFFER, obj->instance_buffer);
+					instance_transform::enable();
+					if (mesh.index_buffer != 0)
+						glDrawElementsInstanced(GL_TRIANGLES, GLsizei(mesh.index_count), GL_UNSIGNED_INT, 0, GLsizei(obj->instances.size()));
+					else
+						glDrawArraysInstanced(GL_TRIANGLES, 0, GLsizei(mesh.vertex_count), GLsizei(obj->instances.size()));
+					instance_transform::disable();
+					// the current value of an attribute is undefined after an array fed it
+					instance_transform::constant();
+					glBindBuffer(GL_ARRAY_BUFFER, 0);
+				}
+				// the shader reads a color for every mesh, so the white constant comes back after a color array
+				if (mesh.streams & stream_colors)
+					set_vertex_layout_constants();
 			}
 		}
+		if (engine.indirect()) {
+			if (indirect_scene == NULL)
+				indirect_scene = new indirect_renderer();
+			indirect_scene->draw(engine, *drawn, views, m_view);
+		}
 
+		if (benchmarking) {
+			if (benchmark_queries[0] != 0)
+				glEndQuery(GL_TIME_ELAPSED);
+			const std::chrono::duration<double, std::milli> cpu_ms = std::chrono::steady_clock::now() - cpu_start;
+			finish_benchmark_frame(cpu_ms.count());
+		}
 		glutSwapBuffers();
 	}
 
@@ -209,18 +479,26 @@ namespace obj_viewer {
 		const float speed = 0.0002f;
 		const glm::vec3 axis = { 0.0f, 1.0f, 0.0f };
 		const glm::quat rotation = glm::angleAxis(speed, axis);
-		const engine& engine = engine::instance();
+		engine& engine = engine::instance();
 		for (const auto& obj : engine.objs)
 			obj->rotate(rotation);
+		engine.hot_reload();
+		asset_registry::instance().update_textures();
+		upload_queue::instance().update();
 		glutPostRedisplay();
 	}
 
 	static void reshape_callback(int width, int height) {
-		const GLfloat FoV = 50.0f;
 		const GLfloat aspect = GLfloat(width == 0 ? 1 : width) / (height == 0 ? 1 : height);
-		const GLuint projection_loc = engine::instance().projection_loc();
-		const glm::mat4 m_projection = glm::perspective(glm::radians(FoV), aspect, 0.1f, 100.0f);
-		glUniformMatrix4fv(projection_loc, 1, GL_FALSE, value_ptr(m_projection));
+		const glm::mat4 m_projection = glm::perspective(glm::radians(field_of_view), aspect, 0.1f, 100.0f);
+		projection_matrix = m_projection;
+		for (unsigned variant = 0; variant < variant_count; ++variant) {
+			const shader_program& program = engine::instance().program(variant);
+			if (program.program == 0)
+				continue;
+			glUseProgram(program.program);
+			glUniformMatrix4fv(program.projection_loc, 1, GL_FALSE, value_ptr(m_projection));
+		}
 
 		glViewport(0, 0, width, height);
 	}
@@ -5,9 +5,46 @@
 #include <memory> // unique_ptr
 #include <GL/glew.h> // GLuint
 #include "object.h" // object
+#include "reloader.h" // reloader
+#include "culling.h" // cull_stats
 
 namespace obj_viewer {
 	
+	enum shader_variant : unsigned {
+		variant_normals = 1,
+		variant_texture = 2,
+		variant_indirect = 4,
+		variant_count = 8
+	};
+
+	class shader_program {
+	public:
+		GLuint program;
+		GLuint model_view_loc;
+		GLuint model_loc;
+		GLuint view_loc;
+		GLuint projection_loc;
+		GLuint light_loc;
+
+		GLuint diffuse_loc;
+		GLuint specular_loc;
+		GLuint ambient_loc;
+		GLuint shininess_loc;
+		GLuint position_offset_loc;
+		GLuint position_scale_loc;
+		GLuint texture_offset_loc;
+		GLuint texture_scale_loc;
+		GLuint texture_loc;
+		GLuint texture_array_loc;
+		GLuint texture_layer_loc;
+		GLuint draw_offset_loc;
+
+		shader_program();
+		void load(const char* vertex_shader, const char* fragment_shader, unsigned variant);
+	};
+
+	unsigned mesh_variant(const mesh& mesh);
+
 	class engine {
 	public:
 		static engine& instance();
@@ -17,33 +54,28 @@ namespace obj_viewer {
 		void init(int* argc, char** argv, const std::string& title, int width, int height);
 		void add_object(std::unique_ptr<object> obj);
 		void run();
+		void hot_reload();
+		void set_benchmark(int frames);
+		void set_indirect(bool indirect);
+		bool indirect() const;
+		void set_culling(bool culling);
+		bool culling() const;
+		void set_occlusion(bool occlusion);
+		bool occlusion() const;
+		// meshes kept and rejected by frustum culling in the last frame
+		cull_stats culling_stats() const;
 
-		GLuint model_view_loc() const;
-		GLuint model_loc() const;
-		GLuint view_loc() const;
-		GLuint projection_loc() const;
-		GLuint light_loc() const;
-
-		GLuint diffuse_loc() const;
-		GLuint specular_loc() const;
-		GLuint ambient_loc() const;
-		GLuint shininess_loc() const;
-		GLuint texture_loc() const;
+		const shader_program& program(unsigned variant) const;
 
 		std::pair<int, int> window_size() const;
 
 	private:
-		GLuint _model_view_loc;
-		GLuint _model_loc;
-		GLuint _view_loc;
-		GLuint _projection_loc;
-		GLuint _light_loc;
-
-		GLuint _diffuse_loc;
-		GLuint _specular_loc;
-		GLuint _ambient_loc;
-		GLuint _shininess_loc;
-		GLuint _texture_loc;
+		std::vector<shader_program> _programs;
+		bool _indirect;
+		bool _culling;
+		bool _occlusion;
+
+		reloader _reloader;
 
 		engine();
 	};
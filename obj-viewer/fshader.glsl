@@ -1,6 +1,7 @@
 #version 330 core
 
 in vec2 UV;
+in vec4 color;
 in vec3 vertexPosition_world;
 in vec3 vertexNormal_camera;
 in vec3 cameraDirection_camera;
@@ -9,20 +10,39 @@ in vec3 lightDirection_camera;
 uniform mat4 ModelView;
 uniform vec3 lightPosition;
 
+#ifdef INDIRECT
+flat in vec3 diffuse;
+flat in vec3 specular;
+flat in vec3 ambient;
+flat in float shininess;
+flat in int textureLayer;
+#else
 uniform vec3 diffuse;
 uniform vec3 specular;
 uniform vec3 ambient;
 uniform float shininess;
+uniform int textureLayer;
+#endif
 uniform sampler2D textureSampler;
+uniform sampler2DArray textureArraySampler;
 
 void main() {
 	vec3 lightColor = vec3(1.0, 1.0, 1.0);
 	float lightPower = 2.0f;
 	
-	vec3 materialDiffuse = texture(textureSampler, UV).rgb * diffuse;
+#ifdef HAS_TEXTURE
+	vec3 texel = textureLayer < 0 ? texture(textureSampler, UV).rgb : texture(textureArraySampler, vec3(UV, textureLayer)).rgb;
+#else
+	vec3 texel = vec3(1.0);
+#endif
+	vec3 materialDiffuse = texel * color.rgb * diffuse;
 	float distance = length(lightPosition - vertexPosition_world);
 
+#ifdef HAS_NORMALS
 	vec3 n = normalize(vertexNormal_camera);
+#else
+	vec3 n = normalize(cross(dFdx(cameraDirection_camera), dFdy(cameraDirection_camera)));
+#endif
 	vec3 l = normalize(lightDirection_camera);
 	float cosTheta = clamp(dot(n, l), 0, 1);
 	
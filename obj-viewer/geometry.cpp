@@ -0,0 +1,361 @@
+#include "geometry.h"
+
+#include <cmath> // isfinite pow sqrt
+#include <cstring> // memcmp memcpy
+#include <algorithm> // min max fill
+#include <unordered_map> // unordered_map
+#include <glm/glm.hpp> // cross dot length normalize
+#include <glm/packing.hpp> // packHalf2x16
+
+namespace obj_viewer {
+
+	static const size_t cache_size = 32;
+
+	quantized_vertices::quantized_vertices() : offset(0.0f), scale(1.0f) {
+		// nop
+	}
+
+	size_t quantized_vertices::size() const {
+		return packed.size();
+	}
+
+	static bool finite(const glm::vec3& v) {
+		return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+	}
+
+	class vertex_key {
+	public:
+		float values[9];
+
+		bool operator==(const vertex_key& other) const {
+			return memcmp(values, other.values, sizeof(values)) == 0;
+		}
+	};
+
+	class vertex_key_hash {
+	public:
+		size_t operator()(const vertex_key& key) const {
+			std::uint32_t words[9];
+			memcpy(words, key.values, sizeof(words));
+			std::uint64_t h = 0xcbf29ce484222325ULL;
+			for (std::uint32_t word : words)
+				h = (h ^ word) * 0x100000001b3ULL;
+			return size_t(h ^ (h >> 32));
+		}
+	};
+
+	static void smooth_normals(vertices& vertices) {
+		std::unordered_map<vertex_key, glm::vec3, vertex_key_hash> sums;
+		sums.reserve(vertices.positions.size());
+
+		for (size_t i = 0; i + 2 < vertices.positions.size(); i += 3) {
+			const glm::vec3 face_normal = glm::cross(vertices.positions[i + 1] - vertices.positions[i], vertices.positions[i + 2] - vertices.positions[i]);
+			for (size_t v = 0; v < 3; ++v) {
+				const glm::vec3& p = vertices.positions[i + v];
+				sums[{ { p.x, p.y, p.z, 0, 0, 0, 0, 0, 0 } }] += face_normal;
+			}
+		}
+
+		for (size_t i = 0; i < vertices.positions.size(); ++i) {
+			const glm::vec3& p = vertices.positions[i];
+			vertices.normals[i] = glm::normalize(sums[{ { p.x, p.y, p.z, 0, 0, 0, 0, 0, 0 } }]);
+		}
+	}
+
+	size_t repair(vertices& vertices) {
+		const size_t triangles = vertices.positions.size() / 3;
+		const bool has_normals = std::any_of(vertices.normals.begin(), vertices.normals.end(), [](const glm::vec3& n) { return n != glm::vec3(0.0f); });
+		const bool has_colors = !vertices.colors.empty();
+		size_t kept = 0;
+
+		for (size_t t = 0; t < triangles; ++t) {
+			const glm::vec3& a = vertices.positions[t * 3 + 0];
+			const glm::vec3& b = vertices.positions[t * 3 + 1];
+			const glm::vec3& c = vertices.positions[t * 3 + 2];
+			if (!finite(a) || !finite(b) || !finite(c))
+				continue;
+
+			const glm::vec3 face_normal = glm::cross(b - a, c - a);
+			const float area = glm::length(face_normal);
+			if (!(area > 0.0f))
+				continue;
+
+			for (size_t v = 0; v < 3; ++v) {
+				vertices.positions[kept * 3 + v] = vertices.positions[t * 3 + v];
+				vertices.texture_coordinates[kept * 3 + v] = vertices.texture_coordinates[t * 3 + v];
+				if (has_colors)
+					vertices.colors[kept * 3 + v] = vertices.colors[t * 3 + v];
+
+				const glm::vec3 normal = vertices.normals[t * 3 + v];
+				const float length = glm::length(normal);
+				vertices.normals[kept * 3 + v] = finite(normal) && length > 0.0f ? normal / length : face_normal / area;
+			}
+			++kept;
+		}
+
+		vertices.positions.resize(kept * 3);
+		vertices.normals.resize(kept * 3);
+		vertices.texture_coordinates.resize(kept * 3);
+		if (has_colors)
+			vertices.colors.resize(kept * 3);
+		if (!has_normals)
+			smooth_normals(vertices);
+		return triangles - kept;
+	}
+
+	std::vector<std::uint32_t> weld(vertices& vertices) {
+		const size_t size = vertices.positions.size();
+		std::vector<std::uint32_t> indices(size);
+		std::unordered_map<vertex_key, std::uint32_t, vertex_key_hash> unique;
+		unique.reserve(size);
+
+		const bool has_colors = !vertices.colors.empty();
+		std::uint32_t count = 0;
+		for (size_t i = 0; i < size; ++i) {
+			const glm::vec3& p = vertices.positions[i];
+			const glm::vec3& n = vertices.normals[i];
+			const glm::vec2& t = vertices.texture_coordinates[i];
+			vertex_key key = { { p.x, p.y, p.z, n.x, n.y, n.z, t.x, t.y, 0 } };
+			if (has_colors)
+				memcpy(&key.values[8], &vertices.colors[i], sizeof(std::uint32_t));
+
+			const auto inserted = unique.emplace(key, count);
+			if (inserted.second) {
+				vertices.positions[count] = p;
+				vertices.normals[count] = n;
+				vertices.texture_coordinates[count] = t;
+				if (has_colors)
+					vertices.colors[count] = vertices.colors[i];
+				++count;
+			}
+			indices[i] = inserted.first->second;
+		}
+
+		vertices.positions.resize(count);
+		vertices.normals.resize(count);
+		vertices.texture_coordinates.resize(count);
+		if (has_colors)
+			vertices.colors.resize(count);
+		return indices;
+	}
+
+	// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+	static float vertex_score(int cache_position, size_t remaining) {
+		if (remaining == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cache_position >= 0) {
+			if (cache_position < 3)
+				score = 0.75f;
+			else
+				score = std::pow(1.0f - float(cache_position - 3) / (cache_size - 3), 1.5f);
+		}
+		return score + 2.0f / std::sqrt(float(remaining));
+	}
+
+	void compute_normals(vertices& vertices, const std::vector<std::uint32_t>& indices) {
+		std::fill(vertices.normals.begin(), vertices.normals.end(), glm::vec3(0.0f));
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			const glm::vec3& a = vertices.positions[indices[i + 0]];
+			const glm::vec3& b = vertices.positions[indices[i + 1]];
+			const glm::vec3& c = vertices.positions[indices[i + 2]];
+			const glm::vec3 face_normal = glm::cross(b - a, c - a);
+			vertices.normals[indices[i + 0]] += face_normal;
+			vertices.normals[indices[i + 1]] += face_normal;
+			vertices.normals[indices[i + 2]] += face_normal;
+		}
+
+		for (auto& normal : vertices.normals) {
+			const float length = glm::length(normal);
+			normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+		}
+	}
+
+	void optimize_vertex_cache(std::vector<std::uint32_t>& indices, size_t vertex_count) {
+		const size_t triangle_count = indices.size() / 3;
+		if (triangle_count == 0)
+			return;
+
+		std::vector<std::uint32_t> offsets(vertex_count + 1, 0);
+		for (std::uint32_t index : indices)
+			offsets[index + 1]++;
+		for (size_t v = 0; v < vertex_count; ++v)
+			offsets[v + 1] += offsets[v];
+
+		std::vector<std::uint32_t> adjacency(indices.size());
+		std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i)
+			adjacency[fill[indices[i]]++] = std::uint32_t(i / 3);
+
+		std::vector<size_t> remaining(vertex_count);
+		std::vector<int> cache_position(vertex_count, -1);
+		std::vector<float> score(vertex_count);
+		for (size_t v = 0; v < vertex_count; ++v) {
+			remaining[v] = offsets[v + 1] - offsets[v];
+			score[v] = vertex_score(-1, remaining[v]);
+		}
+
+		std::vector<float> triangle_score(triangle_count);
+		std::vector<bool> emitted(triangle_count, false);
+		for (size_t t = 0; t < triangle_count; ++t)
+			triangle_score[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+		std::vector<std::uint32_t> result;
+		result.reserve(indices.size());
+		std::vector<std::uint32_t> cache, next_cache;
+		size_t scan = 0;
+		long best = -1;
+
+		while (result.size() < indices.size()) {
+			if (best < 0) {
+				while (emitted[scan])
+					++scan;
+				best = long(scan);
+			}
+
+			emitted[best] = true;
+			next_cache.clear();
+			for (size_t k = 0; k < 3; ++k) {
+				const std::uint32_t v = indices[best * 3 + k];
+				result.push_back(v);
+				next_cache.push_back(v);
+
+				remaining[v]--;
+				std::uint32_t* begin = &adjacency[offsets[v]];
+				std::uint32_t* end = begin + remaining[v] + 1;
+				std::uint32_t* found = std::find(begin, end, std::uint32_t(best));
+				std::swap(*found, *(end - 1));
+			}
+			for (std::uint32_t v : cache) {
+				if (std::find(next_cache.begin(), next_cache.end(), v) == next_cache.end())
+					next_cache.push_back(v);
+			}
+
+			for (size_t i = 0; i < next_cache.size(); ++i)
+				cache_position[next_cache[i]] = i < cache_size ? int(i) : -1;
+
+			best = -1;
+			float best_score = -1.0f;
+			for (std::uint32_t v : next_cache) {
+				const float new_score = vertex_score(cache_position[v], remaining[v]);
+				const float delta = new_score - score[v];
+				score[v] = new_score;
+				for (size_t a = offsets[v]; a < offsets[v] + remaining[v]; ++a) {
+					const std::uint32_t t = adjacency[a];
+					triangle_score[t] += delta;
+					if (triangle_score[t] > best_score) {
+						best_score = triangle_score[t];
+						best = long(t);
+					}
+				}
+			}
+
+			if (next_cache.size() > cache_size)
+				next_cache.resize(cache_size);
+			cache.swap(next_cache);
+		}
+
+		indices.swap(result);
+	}
+
+	void optimize_vertex_fetch(vertices& vertices, std::vector<std::uint32_t>& indices) {
+		const size_t size = vertices.positions.size();
+		std::vector<std::uint32_t> remap(size, ~0u);
+		obj_viewer::vertices result(0);
+		result.positions.reserve(size);
+		result.normals.reserve(size);
+		result.texture_coordinates.reserve(size);
+		result.colors.reserve(vertices.colors.size());
+
+		for (std::uint32_t& index : indices) {
+			if (remap[index] == ~0u) {
+				remap[index] = std::uint32_t(result.positions.size());
+				result.positions.push_back(vertices.positions[index]);
+				result.normals.push_back(vertices.normals[index]);
+				result.texture_coordinates.push_back(vertices.texture_coordinates[index]);
+				if (!vertices.colors.empty())
+					result.colors.push_back(vertices.colors[index]);
+			}
+			index = remap[index];
+		}
+		vertices = std::move(result);
+	}
+
+	float acmr(const std::vector<std::uint32_t>& indices, size_t cache_size) {
+		const size_t triangle_count = indices.size() / 3;
+		if (triangle_count == 0)
+			return 0.0f;
+
+		std::vector<std::uint32_t> fifo(cache_size, ~0u);
+		size_t head = 0;
+		size_t misses = 0;
+		for (std::uint32_t index : indices) {
+			if (std::find(fifo.begin(), fifo.end(), index) != fifo.end())
+				continue;
+			fifo[head] = index;
+			head = (head + 1) % cache_size;
+			++misses;
+		}
+		return float(misses) / triangle_count;
+	}
+
+	static std::int8_t snorm8(float value) {
+		return std::int8_t(std::round(glm::clamp(value, -1.0f, 1.0f) * 127.0f));
+	}
+
+	std::vector<glm::vec3> occluder_proxy(const std::vector<glm::vec3>& positions, const std::vector<std::uint32_t>& indices, size_t max_triangles) {
+		const size_t corners = indices.empty() ? positions.size() : indices.size();
+		std::vector<glm::vec3> result;
+		if (corners / 3 > max_triangles)
+			return result;
+
+		result.reserve(corners - corners % 3);
+		for (size_t i = 0; i + 2 < corners; i += 3) {
+			for (size_t k = i; k < i + 3; ++k)
+				result.push_back(positions[indices.empty() ? k : indices[k]]);
+		}
+		return result;
+	}
+
+	quantized_vertices quantize(const vertices& vertices) {
+		quantized_vertices result;
+		const size_t size = vertices.positions.size();
+		if (size == 0)
+			return result;
+
+		glm::vec3 lower = vertices.positions[0];
+		glm::vec3 upper = vertices.positions[0];
+		for (const glm::vec3& p : vertices.positions) {
+			lower = glm::min(lower, p);
+			upper = glm::max(upper, p);
+		}
+		result.offset = lower;
+		result.scale = glm::max(upper - lower, glm::vec3(1e-20f)) / 65535.0f;
+
+		result.packed.resize(size);
+		for (size_t i = 0; i < size; ++i) {
+			quantized_vertex& packed = result.packed[i];
+			const glm::vec3 q = glm::round((vertices.positions[i] - result.offset) / result.scale);
+			packed.position[0] = std::uint16_t(q.x);
+			packed.position[1] = std::uint16_t(q.y);
+			packed.position[2] = std::uint16_t(q.z);
+			packed.position[3] = 0;
+
+			packed.normal[0] = snorm8(vertices.normals[i].x);
+			packed.normal[1] = snorm8(vertices.normals[i].y);
+			packed.normal[2] = snorm8(vertices.normals[i].z);
+			packed.normal[3] = 0;
+
+			packed.texture_coordinate = glm::packHalf2x16(vertices.texture_coordinates[i]);
+		}
+		return result;
+	}
+
+	std::vector<glm::vec3> dequantize_positions(const quantized_vertex* packed, size_t size, const glm::vec3& offset, const glm::vec3& scale) {
+		std::vector<glm::vec3> result(size);
+		for (size_t i = 0; i < size; ++i)
+			result[i] = offset + glm::vec3(packed[i].position[0], packed[i].position[1], packed[i].position[2]) * scale;
+		return result;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector> // vector
+#include <cstdint> // uint16_t uint32_t int8_t
+#include <glm/vec3.hpp> // vec3
+#include "mesh_data.h" // vertices
+
+namespace obj_viewer {
+
+	// one vertex as cached and uploaded: unorm16 position, snorm8 normal and half2 texture coordinate
+	class quantized_vertex {
+	public:
+		std::uint16_t position[4];
+		std::int8_t normal[4];
+		std::uint32_t texture_coordinate;
+	};
+
+	class quantized_vertices {
+	public:
+		glm::vec3 offset;
+		glm::vec3 scale;
+		std::vector<quantized_vertex> packed;
+
+		quantized_vertices();
+		size_t size() const;
+	};
+
+	size_t repair(vertices& vertices);
+	std::vector<std::uint32_t> weld(vertices& vertices);
+	void compute_normals(vertices& vertices, const std::vector<std::uint32_t>& indices);
+	void optimize_vertex_cache(std::vector<std::uint32_t>& indices, size_t vertex_count);
+	void optimize_vertex_fetch(vertices& vertices, std::vector<std::uint32_t>& indices);
+	float acmr(const std::vector<std::uint32_t>& indices, size_t cache_size);
+	// flat triangle list for occlusion culling, the mesh's own triangles or empty when there are more than max_triangles.
+	// a simplified mesh could stick out of the surface it stands for and hide what is in front of it
+	std::vector<glm::vec3> occluder_proxy(const std::vector<glm::vec3>& positions, const std::vector<std::uint32_t>& indices, size_t max_triangles);
+
+	quantized_vertices quantize(const vertices& vertices);
+	std::vector<glm::vec3> dequantize_positions(const quantized_vertex* packed, size_t size, const glm::vec3& offset, const glm::vec3& scale);
+}
@@ -0,0 +1,32 @@
+#include "gl_handle.h"
+
+#include "registry.h" // asset_registry
+#include "upload.h" // upload_queue
+
+namespace obj_viewer {
+
+	void delete_buffer(GLuint buffer_id) {
+		upload_queue::instance().cancel(buffer_id);
+		glDeleteBuffers(1, &buffer_id);
+	}
+
+	void delete_vertex_array(GLuint vao) {
+		glDeleteVertexArrays(1, &vao);
+	}
+
+	void release_texture_reference(GLuint texture_id) {
+		asset_registry::instance().release_texture(texture_id);
+	}
+
+	gl_buffer create_buffer() {
+		GLuint buffer_id;
+		glGenBuffers(1, &buffer_id);
+		return gl_buffer(buffer_id);
+	}
+
+	gl_vertex_array create_vertex_array() {
+		GLuint vao;
+		glGenVertexArrays(1, &vao);
+		return gl_vertex_array(vao);
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <GL/glew.h> // GLuint
+
+namespace obj_viewer {
+
+	void delete_buffer(GLuint buffer_id);
+	void delete_vertex_array(GLuint vao);
+	void release_texture_reference(GLuint texture_id);
+
+	template <void (*destroy)(GLuint)>
+	class gl_handle {
+	public:
+		gl_handle() : _id(0) {
+			// nop
+		}
+
+		explicit gl_handle(GLuint id) : _id(id) {
+			// nop
+		}
+
+		~gl_handle() {
+			reset();
+		}
+
+		gl_handle(const gl_handle&) = delete;
+		gl_handle& operator=(const gl_handle&) = delete;
+
+		gl_handle(gl_handle&& other) noexcept : _id(other.release()) {
+			// nop
+		}
+
+		gl_handle& operator=(gl_handle&& other) noexcept {
+			if (this != &other)
+				reset(other.release());
+			return *this;
+		}
+
+		operator GLuint() const {
+			return _id;
+		}
+
+		GLuint release() {
+			const GLuint id = _id;
+			_id = 0;
+			return id;
+		}
+
+		void reset(GLuint id = 0) {
+			if (_id != 0)
+				destroy(_id);
+			_id = id;
+		}
+
+	private:
+		GLuint _id;
+	};
+
+	typedef gl_handle<delete_buffer> gl_buffer;
+	typedef gl_handle<delete_vertex_array> gl_vertex_array;
+	typedef gl_handle<release_texture_reference> texture_reference;
+
+	gl_buffer create_buffer();
+	gl_vertex_array create_vertex_array();
+}
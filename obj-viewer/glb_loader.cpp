@@ -0,0 +1,382 @@
+#include "glb_loader.h"
+
+#include <cstring> // memcpy memcmp
+#include <cstdint> // uint8_t uint16_t uint32_t
+#include <iostream> // cerr
+#include <glm/mat4x4.hpp> // mat4
+#include <glm/gtc/type_ptr.hpp> // make_mat4
+#include <glm/gtc/matrix_transform.hpp> // translate scale
+#include "json.h" // json_value parse_json
+#include "registry.h" // asset_registry
+
+namespace obj_viewer {
+
+	enum glb_component {
+		glb_byte = 5120,
+		glb_unsigned_byte = 5121,
+		glb_short = 5122,
+		glb_unsigned_short = 5123,
+		glb_unsigned_int = 5125,
+		glb_float = 5126
+	};
+
+	class glb_accessor {
+	public:
+		const unsigned char* data;
+		size_t count;
+		size_t stride;
+		int component_type;
+		size_t components;
+		bool normalized;
+	};
+
+	class glb_document {
+	public:
+		std::shared_ptr<const mapped_file> file;
+		json_value gltf;
+		const unsigned char* bin;
+		size_t bin_size;
+		std::string texture_directory;
+	};
+
+	static size_t component_size(int component_type) {
+		switch (component_type) {
+		case glb_byte: case glb_unsigned_byte: return 1;
+		case glb_short: case glb_unsigned_short: return 2;
+		case glb_unsigned_int: case glb_float: return 4;
+		default: return 0;
+		}
+	}
+
+	static size_t type_components(const std::string& type) {
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		return 0;
+	}
+
+	// missing properties take the fallback, present ones must be valid sizes
+	static bool read_size(const json_value& value, size_t fallback, size_t& result) {
+		if (value.type == json_value::kind::null) {
+			result = fallback;
+			return true;
+		}
+		return value.as_size(result);
+	}
+
+	static bool find_buffer_view(const glb_document& document, const json_value& view, const unsigned char*& data, size_t& size) {
+		size_t buffer, offset;
+		if (!read_size(view["buffer"], 0, buffer) || !read_size(view["byteOffset"], 0, offset) || !view["byteLength"].as_size(size))
+			return false;
+		if (buffer != 0 || document.bin == NULL || offset > document.bin_size || size > document.bin_size - offset)
+			return false;
+		data = document.bin + offset;
+		return true;
+	}
+
+	static bool find_accessor(const glb_document& document, const json_value& index, glb_accessor& accessor) {
+		const json_value& description = document.gltf["accessors"].at(index);
+		const json_value& view = document.gltf["bufferViews"].at(description["bufferView"]);
+
+		size_t component_type;
+		if (!description["count"].as_size(accessor.count) || !description["componentType"].as_size(component_type) || component_type > glb_float)
+			return false;
+		accessor.component_type = int(component_type);
+		accessor.components = type_components(description["type"].as_string());
+		accessor.normalized = description["normalized"].boolean;
+		const size_t element_size = component_size(accessor.component_type) * accessor.components;
+
+		const unsigned char* data;
+		size_t size, offset;
+		if (element_size == 0 || !read_size(view["byteStride"], element_size, accessor.stride) || !read_size(description["byteOffset"], 0, offset)
+			|| !find_buffer_view(document, view, data, size))
+			return false;
+
+		// the last element has to end inside the view, checked without overflowing
+		if (accessor.count > 0) {
+			if (offset > size || element_size > size - offset)
+				return false;
+			if (accessor.count > 1 && accessor.stride > 0 && (size - offset - element_size) / accessor.stride < accessor.count - 1)
+				return false;
+		}
+		accessor.data = data + offset;
+		return true;
+	}
+
+	static size_t accessor_size(const glb_accessor& accessor) {
+		return accessor.count == 0 ? 0 : (accessor.count - 1) * accessor.stride + component_size(accessor.component_type) * accessor.components;
+	}
+
+	// glTF component types are the matching GL enums
+	static mapped_attribute map_accessor(const glb_accessor& accessor, unsigned stream) {
+		return { stream, accessor.data, accessor_size(accessor), GLenum(accessor.component_type), GLint(accessor.components), accessor.normalized, GLsizei(accessor.stride) };
+	}
+
+	static float read_component(const unsigned char* data, int component_type, bool normalized) {
+		switch (component_type) {
+		case glb_byte: { std::int8_t v; memcpy(&v, data, 1); return normalized ? std::max(v / 127.0f, -1.0f) : v; }
+		case glb_unsigned_byte: return normalized ? *data / 255.0f : *data;
+		case glb_short: { std::int16_t v; memcpy(&v, data, 2); return normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+		case glb_unsigned_short: { std::uint16_t v; memcpy(&v, data, 2); return normalized ? v / 65535.0f : v; }
+		case glb_unsigned_int: { std::uint32_t v; memcpy(&v, data, 4); return float(v); }
+		case glb_float: { float v; memcpy(&v, data, 4); return v; }
+		default: return 0.0f;
+		}
+	}
+
+	template <typename T>
+	static void read_accessor(const glb_accessor& accessor, std::vector<T>& output) {
+		const size_t components = sizeof(T) / sizeof(float);
+		if (accessor.component_type == glb_float && accessor.components == components) {
+			if (accessor.stride == sizeof(T)) {
+				memcpy(output.data(), accessor.data, sizeof(T) * accessor.count);
+			}
+			else {
+				for (size_t i = 0; i < accessor.count; ++i)
+					memcpy(&output[i], accessor.data + i * accessor.stride, sizeof(T));
+			}
+			return;
+		}
+
+		const size_t size = component_size(accessor.component_type);
+		for (size_t i = 0; i < accessor.count; ++i) {
+			float* element = reinterpret_cast<float*>(&output[i]);
+			for (size_t c = 0; c < components && c < accessor.components; ++c)
+				element[c] = read_component(accessor.data + i * accessor.stride + c * size, accessor.component_type, accessor.normalized);
+		}
+	}
+
+	static void read_indices(const glb_accessor& accessor, std::vector<GLuint>& indices) {
+		indices.resize(accessor.count);
+		if (accessor.component_type == glb_unsigned_int && accessor.stride == 4) {
+			memcpy(indices.data(), accessor.data, sizeof(GLuint) * accessor.count);
+			return;
+		}
+
+		for (size_t i = 0; i < accessor.count; ++i) {
+			const unsigned char* index = accessor.data + i * accessor.stride;
+			if (accessor.component_type == glb_unsigned_byte) {
+				indices[i] = *index;
+			}
+			else if (accessor.component_type == glb_unsigned_short) {
+				std::uint16_t value;
+				memcpy(&value, index, sizeof(value));
+				indices[i] = value;
+			}
+			else {
+				memcpy(&indices[i], index, sizeof(GLuint));
+			}
+		}
+	}
+
+	static GLuint acquire_image(const glb_document& document, const json_value& texture_info, std::string& texture_filepath) {
+		if (texture_info.type != json_value::kind::object)
+			return 0;
+		const json_value& texture = document.gltf["textures"].at(texture_info["index"]);
+		const json_value& image = document.gltf["images"].at(texture["source"]);
+
+		if (image.has("bufferView")) {
+			const unsigned char* data;
+			size_t size;
+			if (!find_buffer_view(document, document.gltf["bufferViews"].at(image["bufferView"]), data, size))
+				return 0;
+			return asset_registry::instance().acquire_texture(data, size, document.file);
+		}
+
+		const std::string& uri = image["uri"].as_string();
+		if (!uri.empty() && uri.compare(0, 5, "data:") != 0)
+			texture_filepath = document.texture_directory + uri;
+		return 0;
+	}
+
+	static material read_material(const json_value& description) {
+		material result;
+		const json_value& pbr = description["pbrMetallicRoughness"];
+		const json_value& factor = pbr["baseColorFactor"];
+		const float roughness = float(pbr["roughnessFactor"].as_number(1.0));
+
+		result.name = description["name"].as_string();
+		result.diffuse = { factor[0].as_number(1.0), factor[1].as_number(1.0), factor[2].as_number(1.0) };
+		result.ambient = { 0.1f, 0.1f, 0.1f };
+		result.specular = glm::vec3(0.5f * (1.0f - roughness));
+		result.shininess = 1.0f + 127.0f * (1.0f - roughness);
+		return result;
+	}
+
+	static bool read_primitive(const glb_document& document, const json_value& primitive, const glm::mat4& transform, std::vector<mesh>& meshes) {
+		if (primitive["mode"].as_number(4) != 4) {
+			std::cerr << "GLB: skipping non-triangle primitive\n";
+			return true;
+		}
+
+		const json_value& attributes = primitive["attributes"];
+		glb_accessor positions;
+		if (!find_accessor(document, attributes["POSITION"], positions) || positions.components != 3)
+			return false;
+
+		glb_accessor normals, texture_coordinates, accessor;
+		const bool has_normals = find_accessor(document, attributes["NORMAL"], normals) && normals.count == positions.count;
+		const bool has_texture_coordinates = find_accessor(document, attributes["TEXCOORD_0"], texture_coordinates) && texture_coordinates.count == positions.count;
+
+		mesh mesh(0);
+		if (primitive.has("indices")) {
+			if (!find_accessor(document, primitive["indices"], accessor))
+				return false;
+			read_indices(accessor, mesh.indices);
+			for (const GLuint index : mesh.indices) {
+				if (index >= positions.count)
+					return false;
+			}
+		}
+
+		std::vector<glm::vec3> position_values(positions.count);
+		read_accessor(positions, position_values);
+
+		// untransformed primitives are drawn straight from the mapped views, with the shader flipping v
+		if (transform == glm::mat4(1.0f) && current_vertex_layout() == vertex_layout::separate) {
+			std::vector<mapped_attribute> streams = { map_accessor(positions, 0) };
+			if (has_normals)
+				streams.push_back(map_accessor(normals, stream_normals));
+			if (has_texture_coordinates) {
+				streams.push_back(map_accessor(texture_coordinates, stream_texture_coordinates));
+				mesh.texture_offset = { 0.0f, 1.0f };
+				mesh.texture_scale = { 1.0f, -1.0f };
+			}
+			mesh.bind_buffer(streams, position_values, document.file);
+		}
+		else {
+			mesh.vertices = vertices(positions.count);
+			mesh.vertices.positions = std::move(position_values);
+			if (has_normals)
+				read_accessor(normals, mesh.vertices.normals);
+			if (has_texture_coordinates) {
+				read_accessor(texture_coordinates, mesh.vertices.texture_coordinates);
+				for (auto& uv : mesh.vertices.texture_coordinates)
+					uv.y = 1.0f - uv.y;
+			}
+
+			const glm::mat3 normal_transform = glm::transpose(glm::inverse(glm::mat3(transform)));
+			for (auto& position : mesh.vertices.positions)
+				position = glm::vec3(transform * glm::vec4(position, 1.0f));
+			// missing normals stay zero, which streams() reads as no normal stream; normalizing them would give NaN
+			if (has_normals) {
+				for (auto& normal : mesh.vertices.normals)
+					normal = glm::normalize(normal_transform * normal);
+			}
+		}
+
+		if (primitive.has("material")) {
+			const json_value& description = document.gltf["materials"].at(primitive["material"]);
+			mesh.material = read_material(description);
+			mesh.texture_id.reset(acquire_image(document, description["pbrMetallicRoughness"]["baseColorTexture"], mesh.texture_filepath));
+		}
+		else
+			mesh.material = material::white();
+
+		meshes.push_back(std::move(mesh));
+		return true;
+	}
+
+	static glm::mat4 node_transform(const json_value& node) {
+		const json_value& matrix = node["matrix"];
+		if (matrix.size() == 16) {
+			float values[16];
+			for (size_t i = 0; i < 16; ++i)
+				values[i] = float(matrix[i].as_number());
+			return glm::make_mat4(values);
+		}
+
+		const json_value& t = node["translation"];
+		const json_value& r = node["rotation"];
+		const json_value& s = node["scale"];
+		glm::mat4 result(1.0f);
+		if (t.size() == 3)
+			result = glm::translate(result, glm::vec3(t[0].as_number(), t[1].as_number(), t[2].as_number()));
+		if (r.size() == 4)
+			result = result * glm::mat4_cast(glm::quat(float(r[3].as_number()), float(r[0].as_number()), float(r[1].as_number()), float(r[2].as_number())));
+		if (s.size() == 3)
+			result = glm::scale(result, glm::vec3(s[0].as_number(), s[1].as_number(), s[2].as_number()));
+		return result;
+	}
+
+	static bool read_node(const glb_document& document, const json_value& node_index, const glm::mat4& parent, int depth, std::vector<mesh>& meshes) {
+		const json_value& node = document.gltf["nodes"].at(node_index);
+		const glm::mat4 transform = parent * node_transform(node);
+		if (depth > 64)
+			return false;
+
+		if (node.has("mesh")) {
+			const json_value& primitives = document.gltf["meshes"].at(node["mesh"])["primitives"];
+			for (const auto& primitive : primitives.array) {
+				if (!read_primitive(document, primitive, transform, meshes))
+					return false;
+			}
+		}
+
+		for (const auto& child : node["children"].array) {
+			if (!read_node(document, child, transform, depth + 1, meshes))
+				return false;
+		}
+		return true;
+	}
+
+	bool is_glb(const mapped_file& file) {
+		return file.size() >= 12 && memcmp(file.data(), "glTF", 4) == 0;
+	}
+
+	bool read_glb(std::shared_ptr<const mapped_file> mapping, const std::string& texture_directory, std::vector<mesh>& meshes) {
+		const mapped_file& file = *mapping;
+		if (!is_glb(file))
+			return false;
+
+		glb_document document;
+		document.file = std::move(mapping);
+		document.bin = NULL;
+		document.bin_size = 0;
+		document.texture_directory = texture_directory;
+
+		bool has_json = false;
+		size_t offset = 12;
+		while (offset + 8 <= file.size()) {
+			std::uint32_t chunk_size, chunk_type;
+			memcpy(&chunk_size, file.data() + offset, 4);
+			memcpy(&chunk_type, file.data() + offset + 4, 4);
+			const unsigned char* chunk = file.data() + offset + 8;
+			if (chunk_size > file.size() - offset - 8)
+				return false;
+
+			if (chunk_type == 0x4e4f534a) {
+				const char* text = reinterpret_cast<const char*>(chunk);
+				has_json = parse_json(text, text + chunk_size, document.gltf);
+			}
+			else if (chunk_type == 0x004e4942) {
+				document.bin = chunk;
+				document.bin_size = chunk_size;
+			}
+			offset += 8 + ((chunk_size + 3) & ~size_t(3));
+		}
+		if (!has_json)
+			return false;
+
+		const json_value& scenes = document.gltf["scenes"];
+		if (scenes.size() == 0) {
+			for (const auto& description : document.gltf["meshes"].array) {
+				for (const auto& primitive : description["primitives"].array) {
+					if (!read_primitive(document, primitive, glm::mat4(1.0f), meshes))
+						return false;
+				}
+			}
+			return true;
+		}
+
+		size_t scene_index;
+		if (!read_size(document.gltf["scene"], 0, scene_index))
+			return false;
+		for (const auto& node : scenes[scene_index]["nodes"].array) {
+			if (!read_node(document, node, glm::mat4(1.0f), 0, meshes))
+				return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include <memory> // shared_ptr
+#include "object.h" // mesh
+#include "mapped_file.h" // mapped_file
+
+namespace obj_viewer {
+
+	bool is_glb(const mapped_file& file);
+	// meshes drawn in place keep the mapping alive until their uploads finish
+	bool read_glb(std::shared_ptr<const mapped_file> file, const std::string& texture_directory, std::vector<mesh>& meshes);
+}
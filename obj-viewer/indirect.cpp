@@ -0,0 +1,314 @@
+#include "indirect.h"
+
+#include <map> // map
+#include <algorithm> // min max stable_sort
+#include <numeric> // iota
+#include <glm/gtc/type_ptr.hpp> // value_ptr
+#include "registry.h" // asset_registry
+#include "upload.h" // upload_queue
+#include "vertex_format.h" // vertex_layout_stride set_vertex_layout_pointers set_vertex_layout_constants
+
+namespace obj_viewer {
+
+	static const size_t no_texture = ~size_t(0);
+	static const size_t no_view = ~size_t(0);
+
+	class draw_data {
+	public:
+		glm::vec4 diffuse;
+		glm::vec4 specular;
+		glm::vec4 ambient;
+		glm::vec4 position_offset;
+		glm::vec4 position_scale;
+		glm::vec2 texture_offset;
+		glm::vec2 texture_scale;
+		GLint object;
+		GLint layer;
+		float shininess;
+		float padding;
+	};
+
+	indirect_renderer::arena::arena() : stride(0), vertex_count(0) {
+		// nop
+	}
+
+	bool indirect_renderer::supported() {
+		return GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_shader_draw_parameters && GLEW_ARB_copy_buffer;
+	}
+
+	indirect_renderer::indirect_renderer() : _version(~size_t(0)), _bindings_version(0), _pending_ticket(0) {
+		// nop
+	}
+
+	void indirect_renderer::draw(const engine& engine, const std::vector<size_t>& drawn, const std::vector<object_view>& views, const glm::mat4& view) {
+		if (_version != scene_version() || (_pending_ticket != 0 && upload_queue::instance().ready(_pending_ticket)))
+			rebuild(engine);
+
+		_view_of.assign(engine.objs.size(), no_view);
+		for (size_t i = 0; i < drawn.size(); ++i)
+			_view_of[drawn[i]] = i;
+		update_models(drawn, views);
+		if (_bindings_version != asset_registry::instance().bindings_version())
+			update_bindings();
+
+		// culled draws stay in their batch with no instances, only visible textures are streamed in
+		asset_registry& registry = asset_registry::instance();
+		bool culled = false;
+		for (size_t i = 0; i < _items.size(); ++i) {
+			const draw_item& item = _items[i];
+			const size_t view_index = _view_of[item.object];
+			const bool visible = view_index != no_view && views[view_index].visible[item.mesh_index] != 0;
+			if (visible && item.texture != no_texture)
+				registry.request_texture(_textures[item.texture].texture_id, views[view_index].pixels);
+			const GLuint instance_count = visible ? item.instance_count : 0;
+			if (_command_data[i].instance_count != instance_count) {
+				_command_data[i].instance_count = instance_count;
+				culled = true;
+			}
+		}
+		if (culled) {
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _commands);
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(draw_command) * _command_data.size(), _command_data.data());
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		}
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _objects);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _draws);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _instances);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _commands);
+
+		unsigned bound_variant = variant_count;
+		unsigned bound_streams = ~0u;
+		GLuint bound_texture = 0;
+		GLuint bound_array = 0;
+		for (const batch& batch : _batches) {
+			const shader_program& program = engine.program(batch.variant);
+			if (batch.variant != bound_variant) {
+				glUseProgram(program.program);
+				glUniformMatrix4fv(program.view_loc, 1, GL_FALSE, glm::value_ptr(view));
+				bound_variant = batch.variant;
+			}
+			if (batch.streams != bound_streams) {
+				glBindVertexArray(_arenas[batch.streams].vao);
+				bound_streams = batch.streams;
+			}
+			if ((batch.variant & variant_texture) && batch.binding.layer < 0 && batch.binding.texture_id != bound_texture) {
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, batch.binding.texture_id);
+				bound_texture = batch.binding.texture_id;
+			}
+			else if ((batch.variant & variant_texture) && batch.binding.layer >= 0 && batch.binding.texture_id != bound_array) {
+				glActiveTexture(GL_TEXTURE1);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, batch.binding.texture_id);
+				bound_array = batch.binding.texture_id;
+			}
+
+			glUniform1i(program.draw_offset_loc, GLint(batch.first));
+			const GLvoid* offset = reinterpret_cast<const GLvoid*>(batch.first * sizeof(draw_command));
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, offset, GLsizei(batch.count), 0);
+			// the current color is undefined after a color array fed it, and later batches and passes read it
+			if (batch.streams & stream_colors)
+				set_vertex_layout_constants();
+		}
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindVertexArray(0);
+	}
+
+	void indirect_renderer::rebuild(const engine& engine) {
+		const upload_queue& uploads = upload_queue::instance();
+		_version = scene_version();
+		_pending_ticket = 0;
+		_items.clear();
+		_textures.clear();
+		_arenas.clear();
+		_arenas.resize((stream_normals | stream_texture_coordinates | stream_colors | stream_quantized) + 1);
+
+		std::map<const mesh*, draw_item> placed;
+		std::map<std::pair<size_t, GLuint>, size_t> textures;
+		std::vector<glm::mat4> instances;
+		GLuint index_count = 0;
+		for (size_t o = 0; o < engine.objs.size(); ++o) {
+			const object& obj = *engine.objs[o];
+			const GLuint base_instance = GLuint(instances.size());
+			if (obj.instances.empty())
+				instances.push_back(glm::mat4(1.0f));
+			else
+				instances.insert(instances.end(), obj.instances.begin(), obj.instances.end());
+
+			for (size_t m = 0; m < obj.meshes->size(); ++m) {
+				const mesh& mesh = (*obj.meshes)[m];
+				if (!uploads.ready(mesh.upload_ticket)) {
+					_pending_ticket = std::max(_pending_ticket, mesh.upload_ticket);
+					continue;
+				}
+				if (mesh.vertex_count == 0)
+					continue;
+
+				auto found = placed.find(&mesh);
+				if (found == placed.end()) {
+					arena& arena = _arenas[mesh.streams];
+					draw_item item;
+					item.streams = mesh.streams;
+					item.source = &mesh;
+					item.count = GLuint(mesh.index_buffer != 0 ? mesh.index_count : mesh.vertex_count);
+					item.first_index = index_count;
+					item.base_vertex = GLint(arena.vertex_count);
+					index_count += item.count;
+					arena.vertex_count += mesh.vertex_count;
+					found = placed.emplace(&mesh, item).first;
+				}
+
+				draw_item item = found->second;
+				item.variant = mesh_variant(mesh) | variant_indirect;
+				item.object = o;
+				item.mesh_index = m;
+				item.instance_count = GLuint(obj.instance_count());
+				item.base_instance = base_instance;
+				item.texture = no_texture;
+				if (item.variant & variant_texture) {
+					const auto key = std::make_pair(o, GLuint(mesh.texture_id));
+					auto texture = textures.find(key);
+					if (texture == textures.end()) {
+						texture = textures.emplace(key, _textures.size()).first;
+						_textures.push_back({ mesh.texture_id, o, texture_binding(0, -1) });
+					}
+					item.texture = texture->second;
+				}
+				_items.push_back(item);
+			}
+		}
+
+		if (_indices == 0) {
+			_indices = create_buffer();
+			_commands = create_buffer();
+			_draws = create_buffer();
+			_objects = create_buffer();
+			_instances = create_buffer();
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _instances);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::mat4) * instances.size(), instances.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		_models.clear();
+		glBindBuffer(GL_COPY_WRITE_BUFFER, _indices);
+		glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint) * index_count, NULL, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		for (unsigned streams = 0; streams < _arenas.size(); ++streams) {
+			arena& arena = _arenas[streams];
+			if (arena.vertex_count == 0)
+				continue;
+			arena.stride = vertex_layout_stride(streams);
+			arena.vertices = create_buffer();
+			arena.vao = create_vertex_array();
+			glBindBuffer(GL_COPY_WRITE_BUFFER, arena.vertices);
+			glBufferData(GL_COPY_WRITE_BUFFER, arena.stride * arena.vertex_count, NULL, GL_STATIC_DRAW);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+			glBindVertexArray(arena.vao);
+			glBindBuffer(GL_ARRAY_BUFFER, arena.vertices);
+			set_vertex_layout_pointers(streams);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indices);
+			glBindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+
+		std::vector<GLuint> sequence;
+		for (const auto& entry : placed) {
+			const mesh& mesh = *entry.first;
+			const draw_item& item = entry.second;
+			const arena& arena = _arenas[item.streams];
+
+			glBindBuffer(GL_COPY_READ_BUFFER, mesh.vertex_buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, arena.vertices);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, arena.stride * item.base_vertex, arena.stride * mesh.vertex_count);
+
+			glBindBuffer(GL_COPY_WRITE_BUFFER, _indices);
+			if (mesh.index_buffer != 0) {
+				glBindBuffer(GL_COPY_READ_BUFFER, mesh.index_buffer);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, sizeof(GLuint) * item.first_index, sizeof(GLuint) * item.count);
+			}
+			else {
+				sequence.resize(item.count);
+				std::iota(sequence.begin(), sequence.end(), 0u);
+				glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(GLuint) * item.first_index, sizeof(GLuint) * item.count, sequence.data());
+			}
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		update_bindings();
+	}
+
+	// only the span of drawn objects that moved since they were last drawn is written
+	void indirect_renderer::update_models(const std::vector<size_t>& drawn, const std::vector<object_view>& views) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _objects);
+		if (_models.size() != _view_of.size()) {
+			_models.assign(_view_of.size(), glm::mat4(0.0f));
+			glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::mat4) * _models.size(), NULL, GL_DYNAMIC_DRAW);
+		}
+		size_t first = _models.size(), last = 0;
+		for (size_t i = 0; i < drawn.size(); ++i) {
+			const size_t o = drawn[i];
+			if (_models[o] == views[i].model)
+				continue;
+			_models[o] = views[i].model;
+			first = std::min(first, o);
+			last = std::max(last, o + 1);
+		}
+		if (first < last)
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::mat4) * first, sizeof(glm::mat4) * (last - first), &_models[first]);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	// textures change bindings when they are packed into an array after decoding
+	void indirect_renderer::update_bindings() {
+		const asset_registry& registry = asset_registry::instance();
+		_bindings_version = registry.bindings_version();
+		for (texture_use& use : _textures)
+			use.binding = registry.find_binding(use.texture_id);
+		build_batches();
+	}
+
+	void indirect_renderer::build_batches() {
+		const auto binding = [this](const draw_item& item) {
+			return item.texture == no_texture ? texture_binding(0, -1) : _textures[item.texture].binding;
+		};
+		std::stable_sort(_items.begin(), _items.end(), [&binding](const draw_item& a, const draw_item& b) {
+			if (a.variant != b.variant)
+				return a.variant < b.variant;
+			if (a.streams != b.streams)
+				return a.streams < b.streams;
+			const texture_binding x = binding(a), y = binding(b);
+			// array layers come from the storage buffer, so only the array itself splits batches
+			return x.texture_id < y.texture_id || (x.texture_id == y.texture_id && x.layer < 0 && y.layer >= 0);
+		});
+
+		_batches.clear();
+		_command_data.resize(_items.size());
+		std::vector<draw_data> draws(_items.size());
+		for (size_t i = 0; i < _items.size(); ++i) {
+			const draw_item& item = _items[i];
+			const texture_binding texture = binding(item);
+			const material& material = item.source->material;
+			_command_data[i] = { item.count, item.instance_count, item.first_index, item.base_vertex, item.base_instance };
+			draws[i] = { glm::vec4(material.diffuse, 0.0f), glm::vec4(material.specular, 0.0f), glm::vec4(material.ambient, 0.0f),
+				glm::vec4(item.source->position_offset, 0.0f), glm::vec4(item.source->position_scale, 0.0f),
+				item.source->texture_offset, item.source->texture_scale, GLint(item.object), texture.layer, material.shininess, 0.0f };
+
+			const bool same = !_batches.empty() && _batches.back().variant == item.variant && _batches.back().streams == item.streams
+				&& _batches.back().binding.texture_id == texture.texture_id && (_batches.back().binding.layer < 0) == (texture.layer < 0);
+			if (same)
+				++_batches.back().count;
+			else
+				_batches.push_back({ item.variant, item.streams, texture, i, 1 });
+		}
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _commands);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(draw_command) * _command_data.size(), _command_data.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _draws);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(draw_data) * draws.size(), draws.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+}
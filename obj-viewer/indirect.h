@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector> // vector
+#include <GL/glew.h> // GLuint
+#include <glm/mat4x4.hpp> // mat4
+#include "engine.h" // engine shader_program
+#include "gl_handle.h" // gl_buffer gl_vertex_array
+#include "texture.h" // texture_binding
+
+namespace obj_viewer {
+
+	class draw_command {
+	public:
+		GLuint count;
+		GLuint instance_count;
+		GLuint first_index;
+		GLint base_vertex;
+		GLuint base_instance;
+	};
+
+	class object_view {
+	public:
+		glm::mat4 model;
+		glm::mat4 model_view;
+		float pixels;
+		// one flag per mesh of the object
+		const unsigned char* visible;
+	};
+
+	// draws every mesh out of shared per-stream-set vertex buffers and one index buffer,
+	// with per-draw data and instance transforms in storage buffers and one glMultiDrawElementsIndirect per batch
+	class indirect_renderer {
+	public:
+		static bool supported();
+
+		indirect_renderer();
+		// views[i] belongs to object drawn[i], the draws of every other object get no instances
+		void draw(const engine& engine, const std::vector<size_t>& drawn, const std::vector<object_view>& views, const glm::mat4& view);
+
+	private:
+		class arena {
+		public:
+			gl_vertex_array vao;
+			gl_buffer vertices;
+			size_t stride;
+			size_t vertex_count;
+
+			arena();
+		};
+
+		class draw_item {
+		public:
+			unsigned variant;
+			unsigned streams;
+			size_t object;
+			size_t mesh_index;
+			size_t texture;
+			const mesh* source;
+			GLuint count;
+			GLuint first_index;
+			GLint base_vertex;
+			GLuint instance_count;
+			GLuint base_instance;
+		};
+
+		class batch {
+		public:
+			unsigned variant;
+			unsigned streams;
+			texture_binding binding;
+			size_t first;
+			size_t count;
+		};
+
+		class texture_use {
+		public:
+			GLuint texture_id;
+			size_t object;
+			texture_binding binding;
+		};
+
+		std::vector<arena> _arenas;
+		gl_buffer _indices;
+		gl_buffer _commands;
+		gl_buffer _draws;
+		gl_buffer _objects;
+		gl_buffer _instances;
+		std::vector<draw_item> _items;
+		std::vector<draw_command> _command_data;
+		std::vector<batch> _batches;
+		std::vector<texture_use> _textures;
+		// model matrices last written to the object buffer, one per object
+		std::vector<glm::mat4> _models;
+		// index into this frame's views of every object, no_view when it was not drawn
+		std::vector<size_t> _view_of;
+		size_t _version;
+		size_t _bindings_version;
+		size_t _pending_ticket;
+
+		void rebuild(const engine& engine);
+		void update_models(const std::vector<size_t>& drawn, const std::vector<object_view>& views);
+		void update_bindings();
+		void build_batches();
+	};
+}
@@ -0,0 +1,209 @@
+#include "json.h"
+
+#include <cstdlib> // strtod
+#include <cctype> // isspace
+#include <cmath> // floor
+
+namespace obj_viewer {
+
+	static const json_value null_value;
+	static const size_t max_depth = 128;
+
+	json_value::json_value() : type(kind::null), boolean(false), number(0.0) {
+		// nop
+	}
+
+	bool json_value::has(const std::string& key) const {
+		return object.find(key) != object.end();
+	}
+
+	const json_value& json_value::operator[](const std::string& key) const {
+		const auto found = object.find(key);
+		return found == object.end() ? null_value : found->second;
+	}
+
+	const json_value& json_value::operator[](size_t index) const {
+		return index < array.size() ? array[index] : null_value;
+	}
+
+	const json_value& json_value::at(const json_value& index) const {
+		size_t i;
+		return index.as_size(i) ? (*this)[i] : null_value;
+	}
+
+	size_t json_value::size() const {
+		return type == kind::array ? array.size() : object.size();
+	}
+
+	double json_value::as_number(double fallback) const {
+		return type == kind::number ? number : fallback;
+	}
+
+	bool json_value::as_size(size_t& result) const {
+		// 2^53, past which doubles no longer hold every integer
+		if (type != kind::number || !(number >= 0.0) || number >= 9007199254740992.0 || std::floor(number) != number)
+			return false;
+		result = size_t(number);
+		return true;
+	}
+
+	const std::string& json_value::as_string() const {
+		return string;
+	}
+
+	class json_parser {
+	public:
+		const char* p;
+		const char* end;
+
+		json_parser(const char* begin, const char* end) : p(begin), end(end) {
+			// nop
+		}
+
+		void skip() {
+			while (p < end && isspace(static_cast<unsigned char>(*p)))
+				++p;
+		}
+
+		bool literal(const char* word) {
+			const char* q = p;
+			for (; *word != '\0'; ++word, ++q) {
+				if (q == end || *q != *word)
+					return false;
+			}
+			p = q;
+			return true;
+		}
+
+		bool parse_string(std::string& result) {
+			if (p == end || *p != '"')
+				return false;
+			for (++p; p < end && *p != '"'; ++p) {
+				if (*p != '\\') {
+					result.push_back(*p);
+					continue;
+				}
+				if (++p == end)
+					return false;
+				switch (*p) {
+				case 'b': result.push_back('\b'); break;
+				case 'f': result.push_back('\f'); break;
+				case 'n': result.push_back('\n'); break;
+				case 'r': result.push_back('\r'); break;
+				case 't': result.push_back('\t'); break;
+				case 'u': {
+					if (end - p < 5)
+						return false;
+					const unsigned long code = strtoul(std::string(p + 1, p + 5).c_str(), NULL, 16);
+					if (code < 0x80) {
+						result.push_back(char(code));
+					}
+					else if (code < 0x800) {
+						result.push_back(char(0xc0 | (code >> 6)));
+						result.push_back(char(0x80 | (code & 0x3f)));
+					}
+					else {
+						result.push_back(char(0xe0 | (code >> 12)));
+						result.push_back(char(0x80 | ((code >> 6) & 0x3f)));
+						result.push_back(char(0x80 | (code & 0x3f)));
+					}
+					p += 4;
+					break;
+				}
+				default: result.push_back(*p); break;
+				}
+			}
+			if (p == end)
+				return false;
+			++p;
+			return true;
+		}
+
+		bool parse(json_value& value, size_t depth = 0) {
+			skip();
+			if (p == end || depth > max_depth)
+				return false;
+
+			switch (*p) {
+			case '{':
+				value.type = json_value::kind::object;
+				++p;
+				skip();
+				if (p < end && *p == '}') {
+					++p;
+					return true;
+				}
+				while (true) {
+					std::string key;
+					skip();
+					if (!parse_string(key))
+						return false;
+					skip();
+					if (p == end || *p++ != ':')
+						return false;
+					if (!parse(value.object[key], depth + 1))
+						return false;
+					skip();
+					if (p == end)
+						return false;
+					if (*p == '}') {
+						++p;
+						return true;
+					}
+					if (*p++ != ',')
+						return false;
+				}
+			case '[':
+				value.type = json_value::kind::array;
+				++p;
+				skip();
+				if (p < end && *p == ']') {
+					++p;
+					return true;
+				}
+				while (true) {
+					value.array.emplace_back();
+					if (!parse(value.array.back(), depth + 1))
+						return false;
+					skip();
+					if (p == end)
+						return false;
+					if (*p == ']') {
+						++p;
+						return true;
+					}
+					if (*p++ != ',')
+						return false;
+				}
+			case '"':
+				value.type = json_value::kind::string;
+				return parse_string(value.string);
+			case 't':
+				value.type = json_value::kind::boolean;
+				value.boolean = true;
+				return literal("true");
+			case 'f':
+				value.type = json_value::kind::boolean;
+				return literal("false");
+			case 'n':
+				return literal("null");
+			default: {
+				const char* number_end = p;
+				while (number_end < end && (isdigit(static_cast<unsigned char>(*number_end)) || *number_end == '-' || *number_end == '+' || *number_end == '.' || *number_end == 'e' || *number_end == 'E'))
+					++number_end;
+				if (number_end == p)
+					return false;
+				value.type = json_value::kind::number;
+				value.number = strtod(std::string(p, number_end).c_str(), NULL);
+				p = number_end;
+				return true;
+			}
+			}
+		}
+	};
+
+	bool parse_json(const char* begin, const char* end, json_value& value) {
+		json_parser parser(begin, end);
+		return parser.parse(value);
+	}
+}
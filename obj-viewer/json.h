@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include <map> // map
+
+namespace obj_viewer {
+
+	class json_value {
+	public:
+		enum class kind { null, boolean, number, string, array, object };
+
+		kind type;
+		bool boolean;
+		double number;
+		std::string string;
+		std::vector<json_value> array;
+		std::map<std::string, json_value> object;
+
+		json_value();
+
+		bool has(const std::string& key) const;
+		const json_value& operator[](const std::string& key) const;
+		const json_value& operator[](size_t index) const;
+		// the element named by an index value, null unless the index is a valid size
+		const json_value& at(const json_value& index) const;
+		size_t size() const;
+
+		double as_number(double fallback = 0.0) const;
+		// false for anything but a non-negative integral number that fits a size_t
+		bool as_size(size_t& result) const;
+		const std::string& as_string() const;
+	};
+
+	bool parse_json(const char* begin, const char* end, json_value& value);
+}
@@ -0,0 +1,120 @@
+#include "loader.h"
+
+#include <iostream> // cout cerr
+#include "registry.h" // asset_registry
+#include "cache.h" // read_cache
+#include "mapped_file.h" // mapped_file
+#include "scan_loader.h" // read_ply read_stl
+#include "glb_loader.h" // read_glb
+
+namespace obj_viewer {
+
+	std::unique_ptr<object> read_obj(const std::string& file_directory) {
+		const std::size_t found = file_directory.find_last_of("/\\");
+		const std::string path = file_directory.substr(0, found + 1);
+		const std::string file = file_directory.substr(found + 1);
+		std::cout << "path:" << path << ", file:" << file << '\n';
+
+		obj_file obj;
+		if (!read_obj_file(file_directory, obj))
+			exit(1);
+
+		asset_registry& registry = asset_registry::instance();
+		std::unique_ptr<object> result;
+		std::shared_ptr<std::vector<mesh>> meshes = registry.find_meshes(obj.hash);
+		if (meshes) {
+			std::cout << "shared:" << file_directory << '\n';
+			result = std::make_unique<object>(meshes);
+		}
+		else {
+			if (!parse_obj(obj))
+				exit(1);
+			result = std::make_unique<object>(obj.attrib, obj.shapes, obj.materials, obj.path);
+			registry.add_meshes(obj.hash, result->meshes);
+		}
+
+		result->file_directory = obj.file_directory;
+		result->mtl_directories = obj.mtl_directories;
+		return result;
+	}
+
+	std::unique_ptr<object> read_cache(const std::string& file_directory) {
+		std::cout << "cache:" << file_directory << '\n';
+
+		// the vertices are uploaded straight out of the mapping, which closes once the last upload is copied
+		std::shared_ptr<mapped_file> file = std::make_shared<mapped_file>();
+		std::vector<mapped_mesh> sources;
+		if (!file->open(file_directory) || !read_cache(*file, file_directory, sources)) {
+			std::cerr << "Cannot read cache [" << file_directory << "]\n";
+			exit(1);
+		}
+
+		std::shared_ptr<std::vector<mesh>> meshes = std::make_shared<std::vector<mesh>>();
+		meshes->reserve(sources.size());
+		for (const mapped_mesh& source : sources) {
+			meshes->emplace_back(0);
+			mesh& mesh = meshes->back();
+			mesh.material = source.material;
+			mesh.texture_filepath = source.texture_filepath;
+			mesh.bind_buffer(source, file);
+			mesh.load_texture();
+		}
+		return std::make_unique<object>(meshes);
+	}
+
+	std::unique_ptr<object> read_scan(const std::string& file_directory) {
+		std::cout << "scan:" << file_directory << '\n';
+
+		mapped_file file;
+		std::vector<mesh> meshes;
+		if (!file.open(file_directory)) {
+			std::cerr << "Cannot open [" << file_directory << "]\n";
+			exit(1);
+		}
+
+		const std::string extension = file_extension(file_directory);
+		const bool ply = extension == ".ply" || (extension != ".stl" && is_ply(file));
+		if (!(ply ? read_ply(file, meshes) : read_stl(file, meshes))) {
+			std::cerr << "Cannot read " << (ply ? "PLY" : "STL") << " [" << file_directory << "]\n";
+			exit(1);
+		}
+		return std::make_unique<object>(std::move(meshes));
+	}
+
+	std::unique_ptr<object> read_glb(const std::string& file_directory) {
+		std::cout << "glb:" << file_directory << '\n';
+
+		const auto file = std::make_shared<mapped_file>();
+		std::vector<mesh> meshes;
+		const std::size_t found = file_directory.find_last_of("/\\");
+		const std::string texture_directory = found == std::string::npos ? "" : file_directory.substr(0, found + 1);
+		if (!file->open(file_directory) || !read_glb(file, texture_directory, meshes) || meshes.empty()) {
+			std::cerr << "Cannot read GLB [" << file_directory << "]\n";
+			exit(1);
+		}
+		return std::make_unique<object>(std::move(meshes));
+	}
+
+	std::unique_ptr<object> read_model(const std::string& file_directory) {
+		const std::string extension = file_extension(file_directory);
+		if (extension == ".objcache")
+			return read_cache(file_directory);
+		if (extension == ".ply" || extension == ".stl")
+			return read_scan(file_directory);
+		if (extension == ".glb")
+			return read_glb(file_directory);
+		if (extension != ".obj") {
+			mapped_file file;
+			if (file.open(file_directory)) {
+				const bool glb = is_glb(file);
+				const bool scan = is_ply(file) || is_binary_stl(file);
+				file.close();
+				if (glb)
+					return read_glb(file_directory);
+				if (scan)
+					return read_scan(file_directory);
+			}
+		}
+		return read_obj(file_directory);
+	}
+}
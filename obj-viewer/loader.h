@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include <memory> // unique_ptr
+#include "object.h" // object
+#include "obj_file.h" // obj_file parse_obj file_extension
+
+namespace obj_viewer {
+
+	std::unique_ptr<object> read_obj(const std::string& file_directory);
+	std::unique_ptr<object> read_cache(const std::string& file_directory);
+	std::unique_ptr<object> read_scan(const std::string& file_directory);
+	std::unique_ptr<object> read_glb(const std::string& file_directory);
+	std::unique_ptr<object> read_model(const std::string& file_directory);
+}
@@ -1,67 +1,180 @@
 // obj-viewer - github @enochjung
 
-#define TINYOBJLOADER_IMPLEMENTATION
 #include <iostream>
+#include <cctype>
+#include <cstdlib>
 #include <memory>
+#include <filesystem>
 
+#include "bcn.h"
 #include "engine.h"
+#include "loader.h"
 #include "object.h"
+#include "registry.h"
+#include "stats.h"
+#include "upload.h"
+#include "writer.h"
 
 using namespace obj_viewer;
 
-std::unique_ptr<object> read_obj(const std::string& file_directory) {
-	const std::size_t found = file_directory.find_last_of("/\\");
-	const std::string path = file_directory.substr(0, found + 1);
-	const std::string file = file_directory.substr(found + 1);
-	std::cout << "path:" << path << ", file:" << file << '\n';
-
-	tinyobj::ObjReaderConfig reader_config;
-	reader_config.mtl_search_path = "";
-	reader_config.triangulate = true;
-
-	tinyobj::ObjReader reader;
-
-	if (!reader.ParseFromFile(file_directory, reader_config)) {
-		if (!reader.Error().empty())
-			std::cerr << "TinyObjReader: " << reader.Error();
-		exit(1);
-	}
-	if (!reader.Warning().empty())
-		std::cout << "TinyObjReader: " << reader.Warning();
-
-	const auto& attrib = reader.GetAttrib();
-	const auto& shapes = reader.GetShapes();
-	const auto& materials = reader.GetMaterials();
-	return std::make_unique<object>(attrib, shapes, materials, path);
+static bool parse_count(const char* text, unsigned long max, unsigned long& count) {
+	if (!isdigit(static_cast<unsigned char>(text[0])))
+		return false;
+	char* end = NULL;
+	count = strtoul(text, &end, 10);
+	return *end == '\0' && count <= max;
 }
 
 int main(int argc, char** argv) {
+	if (argc > 1 && std::string(argv[1]) == "--stats") {
+		print_stats(std::vector<std::string>(argv + 2, argv + argc), std::cout);
+		return 0;
+	}
+
 	for (int i = 1; i < argc; ++i)
 		std::cout << "argc[" << i << "] : " << argv[i] << '\n';
 
+	std::string export_directory;
+	block_format compression = block_format::none;
+	size_t texture_budget = 0;
+	size_t upload_budget = 8 << 20;
+	std::error_code temp_error;
+	const std::filesystem::path temp_directory = std::filesystem::temp_directory_path(temp_error);
+	std::string texture_cache = temp_error ? std::string() : (temp_directory / "obj-viewer-textures").string();
+	int max_texture_size = 0;
+	bool release_vertices = false;
+	bool indirect = false;
+	bool culling = true;
+	bool occlusion = false;
+	size_t grid_count = 0;
+	int benchmark_frames = 0;
+	std::vector<std::string> obj_directories;
+	std::vector<int> max_texture_sizes;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--export" && i + 1 < argc)
+			export_directory = argv[++i];
+		else if (arg == "--compress" && i + 1 < argc)
+			compression = parse_block_format(argv[++i]);
+		else if (arg == "--texture-budget" && i + 1 < argc) {
+			unsigned long megabytes;
+			if (!parse_count(argv[++i], size_t(-1) >> 20, megabytes)) {
+				std::cerr << "invalid texture budget : " << argv[i] << '\n';
+				return 1;
+			}
+			texture_budget = size_t(megabytes) << 20;
+		}
+		else if (arg == "--upload-budget" && i + 1 < argc) {
+			unsigned long megabytes;
+			if (!parse_count(argv[++i], 1024, megabytes)) {
+				std::cerr << "invalid upload budget : " << argv[i] << '\n';
+				return 1;
+			}
+			upload_budget = size_t(megabytes) << 20;
+		}
+		else if (arg == "--texture-cache" && i + 1 < argc)
+			texture_cache = argv[++i];
+		else if (arg == "--no-texture-cache")
+			texture_cache.clear();
+		else if (arg == "--release-vertices")
+			release_vertices = true;
+		else if (arg == "--interleave")
+			set_vertex_layout(vertex_layout::interleaved);
+		else if (arg == "--compact-vertices")
+			set_vertex_layout(vertex_layout::compact);
+		else if (arg == "--indirect")
+			indirect = true;
+		else if (arg == "--no-cull")
+			culling = false;
+		else if (arg == "--occlusion")
+			occlusion = true;
+		else if (arg == "--grid" && i + 1 < argc) {
+			unsigned long count;
+			if (!parse_count(argv[++i], 1 << 20, count)) {
+				std::cerr << "invalid grid count : " << argv[i] << '\n';
+				return 1;
+			}
+			grid_count = size_t(count);
+		}
+		else if (arg == "--bench" && i + 1 < argc) {
+			unsigned long frames;
+			if (!parse_count(argv[++i], 1 << 20, frames) || frames == 0) {
+				std::cerr << "invalid benchmark frame count : " << argv[i] << '\n';
+				return 1;
+			}
+			benchmark_frames = int(frames);
+		}
+		else if (arg == "--max-texture" && i + 1 < argc) {
+			unsigned long size;
+			if (!parse_count(argv[++i], 1 << 16, size)) {
+				std::cerr << "invalid max texture size : " << argv[i] << '\n';
+				return 1;
+			}
+			max_texture_size = int(size);
+		}
+		else {
+			obj_directories.push_back(arg);
+			max_texture_sizes.push_back(max_texture_size);
+		}
+	}
+
+	// the shared buffers are filled by copying interleaved per-mesh buffers
+	if (indirect && current_vertex_layout() == vertex_layout::separate)
+		set_vertex_layout(vertex_layout::interleaved);
+
+	asset_registry::instance().set_texture_budget(texture_budget);
+	asset_registry::instance().set_texture_cache(texture_cache);
 	engine& engine = engine::instance();
+	engine.set_indirect(indirect);
+	engine.set_culling(culling);
+	engine.set_occlusion(occlusion);
 
-	if (argc == 1) {
+	if (obj_directories.empty()) {
 		std::string obj_directory;
 
 		std::cout << "input your .obj file directory : ";
 		std::cin >> obj_directory;
 
 		engine.init(&argc, argv, "obj viewer", 800, 800);
-		engine.add_object(std::move(read_obj(obj_directory)));
+		upload_queue::instance().init(upload_budget);
+		asset_registry::instance().set_texture_compression(compression);
+		asset_registry::instance().set_max_texture_size(max_texture_size);
+		std::unique_ptr<object> obj = read_model(obj_directory);
+		if (grid_count > 0)
+			obj->arrange_grid(grid_count);
+		engine.add_object(std::move(obj));
 	}
 	else {
 		engine.init(&argc, argv, "obj viewer", 800, 800);
-		for (int i = 1; i < argc; ++i) {
-			const std::string obj_directory = argv[i];
-			std::unique_ptr<object> obj = read_obj(obj_directory);
-			const float dx = (i - 1) * 1.0f - (argc - 2) * 0.5f;
+		upload_queue::instance().init(upload_budget);
+		asset_registry::instance().set_texture_compression(compression);
+		for (size_t i = 0; i < obj_directories.size(); ++i) {
+			const std::string obj_directory = obj_directories[i];
+			asset_registry::instance().set_max_texture_size(max_texture_sizes[i]);
+			std::unique_ptr<object> obj = read_model(obj_directory);
+			if (grid_count > 0)
+				obj->arrange_grid(grid_count);
+			const float dx = i * 1.0f - (obj_directories.size() - 1) * 0.5f;
 			obj->move(glm::vec3(dx, 0, 0));
 			engine.add_object(std::move(obj));
 		}
 	}
 
+	if (!export_directory.empty()) {
+		std::vector<const object*> objects;
+		for (const auto& obj : engine.objs)
+			objects.push_back(obj.get());
+		if (!write_obj(export_directory, objects))
+			std::cerr << "Cannot export [" << export_directory << "]\n";
+	}
+
+	if (release_vertices) {
+		for (const auto& obj : engine.objs)
+			obj->release_vertices();
+	}
+
+	engine.set_benchmark(benchmark_frames);
 	engine.run();
 
 	return 0;
-}
\ No newline at end of file
+}
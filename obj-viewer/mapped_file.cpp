@@ -0,0 +1,158 @@
+#include "mapped_file.h"
+
+#include <cstdio> // fopen fread
+#include <cstring> // memcpy
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h> // open
+#include <unistd.h> // close
+#include <sys/mman.h> // mmap munmap
+#include <sys/stat.h> // fstat
+#endif
+
+namespace obj_viewer {
+
+#ifdef _WIN32
+	mapped_file::mapped_file() : _data(NULL), _size(0), _file(INVALID_HANDLE_VALUE), _mapping(NULL) {
+		// nop
+	}
+#else
+	mapped_file::mapped_file() : _data(NULL), _size(0) {
+		// nop
+	}
+#endif
+
+	mapped_file::~mapped_file() {
+		close();
+	}
+
+	bool mapped_file::open(const std::string& filepath) {
+		close();
+
+#ifdef _WIN32
+		_file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (_file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0) {
+			close();
+			return false;
+		}
+
+		_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (_mapping == NULL) {
+			close();
+			return false;
+		}
+
+		_data = static_cast<const unsigned char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+		if (_data == NULL) {
+			close();
+			return false;
+		}
+		_size = size_t(size.QuadPart);
+#else
+		const int fd = ::open(filepath.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+
+		void* data = mmap(NULL, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (data == MAP_FAILED)
+			return false;
+
+		madvise(data, size_t(info.st_size), MADV_SEQUENTIAL);
+		_data = static_cast<const unsigned char*>(data);
+		_size = size_t(info.st_size);
+#endif
+		return true;
+	}
+
+	void mapped_file::close() {
+#ifdef _WIN32
+		if (_data != NULL)
+			UnmapViewOfFile(_data);
+		if (_mapping != NULL)
+			CloseHandle(_mapping);
+		if (_file != INVALID_HANDLE_VALUE)
+			CloseHandle(_file);
+		_mapping = NULL;
+		_file = INVALID_HANDLE_VALUE;
+#else
+		if (_data != NULL)
+			munmap(const_cast<unsigned char*>(_data), _size);
+#endif
+		_data = NULL;
+		_size = 0;
+	}
+
+	const unsigned char* mapped_file::data() const {
+		return _data;
+	}
+
+	size_t mapped_file::size() const {
+		return _size;
+	}
+
+	// MurmurHash64A
+	std::uint64_t hash_bytes(const void* data, size_t size, std::uint64_t seed) {
+		const std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+		const int r = 47;
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		std::uint64_t h = seed ^ (size * m);
+
+		const size_t blocks = size / 8;
+		for (size_t i = 0; i < blocks; ++i) {
+			std::uint64_t k;
+			memcpy(&k, bytes + i * 8, sizeof(k));
+			k *= m;
+			k ^= k >> r;
+			k *= m;
+			h ^= k;
+			h *= m;
+		}
+
+		const unsigned char* tail = bytes + blocks * 8;
+		switch (size & 7) {
+		case 7: h ^= std::uint64_t(tail[6]) << 48;
+		case 6: h ^= std::uint64_t(tail[5]) << 40;
+		case 5: h ^= std::uint64_t(tail[4]) << 32;
+		case 4: h ^= std::uint64_t(tail[3]) << 24;
+		case 3: h ^= std::uint64_t(tail[2]) << 16;
+		case 2: h ^= std::uint64_t(tail[1]) << 8;
+		case 1: h ^= std::uint64_t(tail[0]);
+			h *= m;
+		}
+
+		h ^= h >> r;
+		h *= m;
+		h ^= h >> r;
+		return h;
+	}
+
+	bool read_file(const std::string& filepath, std::vector<char>& bytes) {
+		FILE* fp = fopen(filepath.c_str(), "rb");
+		if (fp == NULL)
+			return false;
+
+		fseek(fp, 0L, SEEK_END);
+		const long size = ftell(fp);
+		fseek(fp, 0L, SEEK_SET);
+
+		bytes.resize(size > 0 ? size : 0);
+		const size_t read = fread(bytes.data(), 1, bytes.size(), fp);
+		fclose(fp);
+		return read == bytes.size();
+	}
+}
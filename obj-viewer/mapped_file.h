@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include <cstdint> // uint64_t
+
+namespace obj_viewer {
+
+	std::uint64_t hash_bytes(const void* data, size_t size, std::uint64_t seed = 0);
+	bool read_file(const std::string& filepath, std::vector<char>& bytes);
+
+	class mapped_file {
+	public:
+		mapped_file();
+		~mapped_file();
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		bool open(const std::string& filepath);
+		void close();
+
+		const unsigned char* data() const;
+		size_t size() const;
+
+	private:
+		const unsigned char* _data;
+		size_t _size;
+#ifdef _WIN32
+		void* _file;
+		void* _mapping;
+#endif
+	};
+}
@@ -0,0 +1,112 @@
+#include "mesh_data.h"
+
+#include <algorithm> // any_of
+#include <glm/glm.hpp> // clamp
+#include <glm/packing.hpp> // packUnorm4x8
+
+namespace obj_viewer {
+
+	vertices::vertices(size_t size) : positions(size), normals(size), texture_coordinates(size) {
+		// nop
+	}
+
+	bool vertices::operator==(const vertices& other) const {
+		return positions == other.positions && normals == other.normals && texture_coordinates == other.texture_coordinates && colors == other.colors;
+	}
+
+	unsigned vertices::streams() const {
+		const size_t size = positions.size();
+		unsigned result = 0;
+		if (normals.size() == size && std::any_of(normals.begin(), normals.end(), [](const glm::vec3& n) { return n != glm::vec3(0.0f); }))
+			result |= stream_normals;
+		if (texture_coordinates.size() == size && std::any_of(texture_coordinates.begin(), texture_coordinates.end(), [](const glm::vec2& t) { return t != glm::vec2(0.0f); }))
+			result |= stream_texture_coordinates;
+		if (size > 0 && colors.size() == size)
+			result |= stream_colors;
+		return result;
+	}
+
+	material::material() : diffuse({ 0, 0, 0 }), specular({ 0, 0, 0 }), ambient({ 0, 0, 0 }), shininess(0) {
+		// nop
+	}
+
+	material::material(const tinyobj::material_t& material) : name(material.name),
+		diffuse({ material.diffuse[0], material.diffuse[1], material.diffuse[2] }),
+		specular({ material.specular[0], material.specular[1], material.specular[2] }),
+		ambient({ material.ambient[0], material.ambient[1], material.ambient[2] }),
+		shininess(material.shininess) {
+		// nop
+	}
+
+	bool material::operator==(const material& other) const {
+		return name == other.name && diffuse == other.diffuse && specular == other.specular && ambient == other.ambient && shininess == other.shininess;
+	}
+
+	material material::white() {
+		material result;
+		result.diffuse = { 1.0f, 1.0f, 1.0f };
+		result.ambient = { 0.1f, 0.1f, 0.1f };
+		return result;
+	}
+
+	mesh_data::mesh_data(size_t vertices_size) : vertices(vertices_size), material() {
+		// nop
+	}
+
+	std::vector<mesh_data> build_meshes(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, const std::vector<tinyobj::material_t>& materials, const std::string texture_directory) {
+		std::vector<mesh_data> result;
+		result.reserve(shapes.size());
+
+		const bool has_colors = !attrib.colors.empty() && attrib.colors.size() == attrib.vertices.size();
+
+		for (size_t s = 0; s < shapes.size(); s++) {
+			const size_t vertices_size = shapes[s].mesh.num_face_vertices.size() * 3;
+			mesh_data mesh(vertices_size);
+			if (has_colors)
+				mesh.vertices.colors.resize(vertices_size);
+
+			size_t index_offset = 0;
+			for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
+				size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
+
+				for (size_t v = 0; v < fv; v++) {
+					tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
+					tinyobj::real_t vx = attrib.vertices[3 * size_t(idx.vertex_index) + 0];
+					tinyobj::real_t vy = attrib.vertices[3 * size_t(idx.vertex_index) + 1];
+					tinyobj::real_t vz = attrib.vertices[3 * size_t(idx.vertex_index) + 2];
+					mesh.vertices.positions[index_offset + v] = glm::vec3(vx, vy, vz);
+
+					if (has_colors) {
+						const glm::vec3 color = glm::clamp(glm::vec3(attrib.colors[3 * size_t(idx.vertex_index) + 0], attrib.colors[3 * size_t(idx.vertex_index) + 1], attrib.colors[3 * size_t(idx.vertex_index) + 2]), 0.0f, 1.0f);
+						mesh.vertices.colors[index_offset + v] = glm::packUnorm4x8(glm::vec4(color, 1.0f));
+					}
+
+					if (idx.normal_index >= 0) {
+						tinyobj::real_t nx = attrib.normals[3 * size_t(idx.normal_index) + 0];
+						tinyobj::real_t ny = attrib.normals[3 * size_t(idx.normal_index) + 1];
+						tinyobj::real_t nz = attrib.normals[3 * size_t(idx.normal_index) + 2];
+						mesh.vertices.normals[index_offset + v] = glm::vec3(nx, ny, nz);
+					}
+
+					if (idx.texcoord_index >= 0) {
+						tinyobj::real_t tx = attrib.texcoords[2 * size_t(idx.texcoord_index) + 0];
+						tinyobj::real_t ty = attrib.texcoords[2 * size_t(idx.texcoord_index) + 1];
+						mesh.vertices.texture_coordinates[index_offset + v] = glm::vec2(tx, ty);
+					}
+				}
+				index_offset += fv;
+			}
+
+			const int mat_idx = shapes[s].mesh.material_ids[0];
+			if (mat_idx >= 0) {
+				const auto& material = materials[mat_idx];
+				mesh.material = obj_viewer::material(material);
+				if (material.diffuse_texname.length() > 0)
+					mesh.texture_filepath = texture_directory + material.diffuse_texname;
+			}
+
+			result.push_back(std::move(mesh));
+		}
+		return result;
+	}
+}
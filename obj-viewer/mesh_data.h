@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include <cstdint> // uint32_t
+#include <glm/vec2.hpp> // vec2
+#include <glm/vec3.hpp> // vec3
+#include "tiny_obj_loader.h"
+
+namespace obj_viewer {
+
+	enum vertex_stream : unsigned {
+		stream_normals = 1,
+		stream_texture_coordinates = 2,
+		stream_colors = 4,
+		// positions are unorm16 relative to a per-mesh offset and scale, laid out as quantized_format
+		stream_quantized = 8
+	};
+
+	class vertices {
+	public:
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> texture_coordinates;
+		std::vector<std::uint32_t> colors;
+
+		vertices(size_t size);
+		bool operator==(const vertices& other) const;
+		unsigned streams() const;
+	};
+
+	class material {
+	public:
+		std::string name;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+		glm::vec3 ambient;
+		float shininess;
+
+		material();
+		material(const tinyobj::material_t& material);
+		bool operator==(const material& other) const;
+		// for models that carry no material: PLY and STL scans and GLB primitives without one
+		static material white();
+	};
+
+	// the cpu side of a mesh, built without a GL context
+	class mesh_data {
+	public:
+		std::string texture_filepath;
+		vertices vertices;
+		std::vector<std::uint32_t> indices;
+		material material;
+
+		mesh_data(size_t vertices_size);
+	};
+
+	std::vector<mesh_data> build_meshes(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, const std::vector<tinyobj::material_t>& materials, const std::string texture_directory);
+}
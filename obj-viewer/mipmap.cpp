@@ -0,0 +1,167 @@
+#include "mipmap.h"
+
+#include <cmath> // pow
+#include <thread> // thread
+#include <algorithm> // min max
+#include <cstdint> // uint16_t
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPMAP_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace obj_viewer {
+
+	class linear_image {
+	public:
+		int width;
+		int height;
+		std::vector<std::uint16_t> texels;
+	};
+
+	class srgb_tables {
+	public:
+		std::uint16_t to_linear[256];
+		std::vector<unsigned char> to_srgb;
+
+		srgb_tables() : to_srgb(65536) {
+			for (int i = 0; i < 256; ++i) {
+				const double c = i / 255.0;
+				const double linear = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+				to_linear[i] = std::uint16_t(linear * 65535.0 + 0.5);
+			}
+			for (int i = 0; i < 65536; ++i) {
+				const double linear = i / 65535.0;
+				const double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+				to_srgb[i] = static_cast<unsigned char>(std::min(255.0, c * 255.0 + 0.5));
+			}
+		}
+	};
+
+	static const srgb_tables& tables() {
+		static const srgb_tables instance;
+		return instance;
+	}
+
+	template <typename F>
+	static void parallel_rows(int rows, size_t threads, F task) {
+		threads = std::max<size_t>(1, std::min<size_t>(threads, size_t(rows) / 64 + 1));
+		std::vector<std::thread> workers;
+		for (size_t t = 1; t < threads; ++t)
+			workers.emplace_back(task, int(rows * t / threads), int(rows * (t + 1) / threads));
+		task(0, int(rows / threads));
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	static void downsample_rows(const linear_image& source, linear_image& target, int first_row, int last_row) {
+		const int last_x = source.width - 1;
+		const int last_y = source.height - 1;
+
+		for (int y = first_row; y < last_row; ++y) {
+			const std::uint16_t* row0 = &source.texels[size_t(std::min(y * 2, last_y)) * source.width * 4];
+			const std::uint16_t* row1 = &source.texels[size_t(std::min(y * 2 + 1, last_y)) * source.width * 4];
+			std::uint16_t* out = &target.texels[size_t(y) * target.width * 4];
+			int x = 0;
+
+#ifdef MIPMAP_SSE2
+			for (; x + 1 < target.width && x * 2 + 3 <= last_x; x += 2) {
+				const __m128i top01 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+				const __m128i top23 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 8));
+				const __m128i bottom01 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+				const __m128i bottom23 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 8));
+				const __m128i vertical01 = _mm_avg_epu16(top01, bottom01);
+				const __m128i vertical23 = _mm_avg_epu16(top23, bottom23);
+				const __m128i even = _mm_unpacklo_epi64(vertical01, vertical23);
+				const __m128i odd = _mm_unpackhi_epi64(vertical01, vertical23);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_avg_epu16(even, odd));
+			}
+#endif
+			for (; x < target.width; ++x) {
+				const int x0 = std::min(x * 2, last_x) * 4;
+				const int x1 = std::min(x * 2 + 1, last_x) * 4;
+				for (int c = 0; c < 4; ++c)
+					out[x * 4 + c] = std::uint16_t((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+			}
+		}
+	}
+
+	static image to_image(const linear_image& source, int components, size_t threads) {
+		const auto& to_srgb = tables().to_srgb;
+		image result;
+		result.width = source.width;
+		result.height = source.height;
+		result.components = components;
+		result.pixels.resize(size_t(source.width) * source.height * components);
+
+		parallel_rows(source.height, threads, [&](int first_row, int last_row) {
+			for (size_t i = size_t(first_row) * source.width; i < size_t(last_row) * source.width; ++i) {
+				for (int c = 0; c < 3; ++c)
+					result.pixels[i * components + c] = to_srgb[source.texels[i * 4 + c]];
+				if (components == 4)
+					result.pixels[i * 4 + 3] = static_cast<unsigned char>(source.texels[i * 4 + 3] >> 8);
+			}
+		});
+		return result;
+	}
+
+	static linear_image halve(const linear_image& level, size_t threads) {
+		linear_image next;
+		next.width = std::max(1, level.width / 2);
+		next.height = std::max(1, level.height / 2);
+		next.texels.resize(size_t(next.width) * next.height * 4);
+		parallel_rows(next.height, threads, [&](int first_row, int last_row) {
+			downsample_rows(level, next, first_row, last_row);
+		});
+		return next;
+	}
+
+	std::vector<image> build_mip_chain(image base, size_t threads, int max_size) {
+		std::vector<image> result;
+		result.push_back(std::move(base));
+		const image& source = result[0];
+		const bool capped = max_size > 0 && std::max(source.width, source.height) > max_size;
+		if (source.width <= 1 && source.height <= 1)
+			return result;
+
+		const auto& to_linear = tables().to_linear;
+		linear_image level;
+		level.width = source.width;
+		level.height = source.height;
+		level.texels.resize(size_t(source.width) * source.height * 4);
+		parallel_rows(source.height, threads, [&](int first_row, int last_row) {
+			for (size_t i = size_t(first_row) * source.width; i < size_t(last_row) * source.width; ++i) {
+				for (int c = 0; c < 3; ++c)
+					level.texels[i * 4 + c] = to_linear[source.pixels[i * source.components + c]];
+				level.texels[i * 4 + 3] = source.components == 4 ? std::uint16_t(source.pixels[i * 4 + 3] * 257) : 65535;
+			}
+		});
+
+		const int components = source.components;
+		const std::uint64_t hash = source.hash;
+		if (capped) {
+			while (std::max(level.width, level.height) > max_size)
+				level = halve(level, threads);
+			result[0] = to_image(level, components, threads);
+			result[0].hash = hash;
+		}
+
+		while (level.width > 1 || level.height > 1) {
+			linear_image next = halve(level, threads);
+			result.push_back(to_image(next, components, threads));
+			result.back().hash = hash;
+			level = std::move(next);
+		}
+		return result;
+	}
+
+	size_t mip_chain_bytes(int width, int height, int components) {
+		size_t bytes = size_t(width) * height * components;
+		while (width > 1 || height > 1) {
+			width = std::max(1, width / 2);
+			height = std::max(1, height / 2);
+			bytes += size_t(width) * height * components;
+		}
+		return bytes;
+	}
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <vector> // vector
+#include "object.h" // image
+
+namespace obj_viewer {
+
+	std::vector<image> build_mip_chain(image base, size_t threads, int max_size = 0);
+	size_t mip_chain_bytes(int width, int height, int components);
+}
@@ -0,0 +1,111 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "obj_file.h"
+
+#include <iostream> // cerr
+#include <fstream> // ifstream
+#include <sstream> // istringstream
+#include <streambuf> // streambuf
+#include <algorithm> // find transform
+#include "mapped_file.h" // read_file hash_bytes
+
+namespace obj_viewer {
+
+	class memory_buffer : public std::streambuf {
+	public:
+		memory_buffer(std::vector<char>& bytes) {
+			setg(bytes.data(), bytes.data(), bytes.data() + bytes.size());
+		}
+	};
+
+	static std::vector<std::string> find_mtllibs(const std::vector<char>& obj_text, const std::string& path) {
+		std::vector<std::string> result;
+		const char* line = obj_text.data();
+		const char* end = line + obj_text.size();
+
+		while (line < end) {
+			const char* line_end = std::find(line, end, '\n');
+			if (line_end - line > 7 && std::string(line, 6) == "mtllib" && isspace(line[6])) {
+				std::istringstream names(std::string(line + 7, line_end));
+				std::string name;
+				while (names >> name)
+					result.push_back(path + name);
+			}
+			line = line_end + 1;
+		}
+		return result;
+	}
+
+	bool read_obj_file(const std::string& file_directory, obj_file& file) {
+		const std::size_t found = file_directory.find_last_of("/\\");
+		file.file_directory = file_directory;
+		file.path = file_directory.substr(0, found + 1);
+
+		if (!read_file(file_directory, file.obj_text)) {
+			std::cerr << "TinyObjReader: Cannot open file [" << file_directory << "]\n";
+			return false;
+		}
+		file.mtl_directories = find_mtllibs(file.obj_text, file.path);
+
+		file.hash = hash_bytes(file.obj_text.data(), file.obj_text.size());
+		for (const std::string& mtl_directory : file.mtl_directories) {
+			std::vector<char> mtl_text;
+			if (!read_file(mtl_directory, mtl_text)) {
+				std::cerr << "TinyObjReader: Material file [ " << mtl_directory << " ] not found\n";
+				continue;
+			}
+			file.hash = hash_bytes(mtl_text.data(), mtl_text.size(), file.hash);
+			file.mtl_text.insert(file.mtl_text.end(), mtl_text.begin(), mtl_text.end());
+			file.mtl_text.push_back('\n');
+		}
+		file.hash = hash_bytes(file.path.data(), file.path.size(), file.hash);
+		return true;
+	}
+
+	bool parse_obj(obj_file& file) {
+		memory_buffer obj_buffer(file.obj_text);
+		memory_buffer mtl_buffer(file.mtl_text);
+		std::istream obj_stream(&obj_buffer);
+		std::istream mtl_stream(&mtl_buffer);
+		tinyobj::MaterialStreamReader mtl_reader(mtl_stream);
+
+		std::string warning, error;
+		const bool valid = tinyobj::LoadObj(&file.attrib, &file.shapes, &file.materials, &warning, &error, &obj_stream, &mtl_reader, true, false);
+		if (!valid) {
+			if (!error.empty())
+				std::cerr << "TinyObjReader: " << error;
+			return false;
+		}
+		if (!warning.empty())
+			std::cerr << "TinyObjReader: " << warning;
+
+		file.obj_text = std::vector<char>();
+		file.mtl_text = std::vector<char>();
+		return true;
+	}
+
+	bool parse_obj(const std::string& file_directory, obj_file& file) {
+		return read_obj_file(file_directory, file) && parse_obj(file);
+	}
+
+	bool parse_mtl(const std::string& mtl_directory, std::vector<tinyobj::material_t>& materials) {
+		std::ifstream stream(mtl_directory);
+		if (!stream)
+			return false;
+
+		std::map<std::string, int> material_map;
+		std::string warning, error;
+		tinyobj::LoadMtl(&material_map, &materials, &stream, &warning, &error);
+		if (!warning.empty())
+			std::cerr << "TinyObjReader: " << warning;
+		return true;
+	}
+
+	std::string file_extension(const std::string& file_directory) {
+		const std::size_t found = file_directory.find_last_of("./\\");
+		if (found == std::string::npos || file_directory[found] != '.')
+			return "";
+		std::string extension = file_directory.substr(found);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(tolower(c)); });
+		return extension;
+	}
+}
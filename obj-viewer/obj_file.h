@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include <cstdint> // uint64_t
+#include "tiny_obj_loader.h"
+
+namespace obj_viewer {
+
+	class obj_file {
+	public:
+		std::string file_directory;
+		std::string path;
+		std::vector<std::string> mtl_directories;
+		std::uint64_t hash;
+		std::vector<char> obj_text;
+		std::vector<char> mtl_text;
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+	};
+
+	bool read_obj_file(const std::string& file_directory, obj_file& file);
+	bool parse_obj(obj_file& file);
+	bool parse_obj(const std::string& file_directory, obj_file& file);
+	bool parse_mtl(const std::string& mtl_directory, std::vector<tinyobj::material_t>& materials);
+
+	std::string file_extension(const std::string& file_directory);
+}
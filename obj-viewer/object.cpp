@@ -1,124 +1,380 @@
 #include "object.h"
 
 #include <algorithm> // min max
+#include <cmath> // ceil sqrt
+#include <chrono> // seconds
+#include <glm/gtc/matrix_transform.hpp> // translate
+#include "registry.h" // asset_registry read_file hash_bytes
+#include "upload.h" // upload_queue
+#include "geometry.h" // occluder_proxy dequantize_positions
+#include "thread_pool.h" // thread_pool
+#include "cache.h" // mapped_mesh
+#include "vertex_format.h" // separate_format interleaved_format compact_format quantized_format
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 namespace obj_viewer {
 
-	vertices::vertices(size_t size) : positions(size), normals(size), texture_coordinates(size) {
+	static vertex_layout buffer_layout = vertex_layout::separate;
+	static bool occluder_proxies = false;
+	// meshes with more triangles do not occlude, the occlusion buffer renders at most a few of these a frame
+	static const size_t max_occluder_triangles = 4096;
+	static size_t scene_changes = 0;
+	static std::vector<object*> moved_objects;
+
+	void set_vertex_layout(vertex_layout layout) {
+		buffer_layout = layout;
+	}
+
+	vertex_layout current_vertex_layout() {
+		return buffer_layout;
+	}
+
+	void set_occluder_proxies(bool enabled) {
+		occluder_proxies = enabled;
+	}
+
+	std::string vertex_layout_defines() {
+		switch (buffer_layout) {
+		case vertex_layout::interleaved:
+			return interleaved_format::defines() + instance_transform::define();
+		case vertex_layout::compact:
+			return compact_format::defines() + instance_transform::define();
+		default:
+			return separate_format::defines() + instance_transform::define();
+		}
+	}
+
+	void set_vertex_layout_constants() {
+		instance_transform::constant();
+		switch (buffer_layout) {
+		case vertex_layout::interleaved:
+			interleaved_format::constants();
+			break;
+		case vertex_layout::compact:
+			compact_format::constants();
+			break;
+		default:
+			separate_format::constants();
+			break;
+		}
+	}
+
+	size_t vertex_layout_stride(unsigned streams) {
+		if (streams & stream_quantized)
+			return quantized_format::stride(quantized_format::streams);
+		if (buffer_layout == vertex_layout::compact)
+			return compact_format::stride(streams);
+		return interleaved_format::stride(streams);
+	}
+
+	void set_vertex_layout_pointers(unsigned streams) {
+		if (streams & stream_quantized) {
+			quantized_format::enable(streams);
+			quantized_format::pointers(quantized_format::streams);
+		}
+		else if (buffer_layout == vertex_layout::compact) {
+			compact_format::enable(streams);
+			compact_format::pointers(streams);
+		}
+		else {
+			interleaved_format::enable(streams);
+			interleaved_format::pointers(streams);
+		}
+	}
+
+	size_t scene_version() {
+		return scene_changes;
+	}
+
+	void mark_scene_changed() {
+		++scene_changes;
+	}
+
+	std::vector<object*> take_moved_objects() {
+		std::vector<object*> result;
+		result.swap(moved_objects);
+		for (object* obj : result)
+			obj->_moved = false;
+		return result;
+	}
+
+	// gathers the occluder on a worker so loading on the GL thread does not wait for it
+	static std::shared_future<std::vector<glm::vec3>> build_occluder(const std::vector<glm::vec3>& positions, const std::vector<std::uint32_t>& indices) {
+		const size_t corners = indices.empty() ? positions.size() : indices.size();
+		if (!occluder_proxies || corners < 3 || corners / 3 > max_occluder_triangles)
+			return std::shared_future<std::vector<glm::vec3>>();
+
+		static thread_pool pool(1);
+		return pool.submit([positions, indices]() { return occluder_proxy(positions, indices, max_occluder_triangles); }).share();
+	}
+
+	static gl_buffer& stream_buffer(mesh& mesh, unsigned stream) {
+		switch (stream) {
+		case stream_normals:
+			return mesh.normal_buffer;
+		case stream_texture_coordinates:
+			return mesh.uv_buffer;
+		case stream_colors:
+			return mesh.color_buffer;
+		default:
+			return mesh.vertex_buffer;
+		}
+	}
+
+	template <typename Format>
+	static void upload_vertices(mesh& mesh) {
+		upload_queue& uploads = upload_queue::instance();
+		Format::enable(mesh.streams);
+
+		if constexpr (Format::interleaved) {
+			glBindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer);
+			Format::pointers(mesh.streams);
+			const std::vector<unsigned char> packed = Format::pack(mesh.vertices, mesh.streams);
+			mesh.upload_ticket = uploads.upload_buffer(mesh.vertex_buffer, packed.data(), packed.size());
+		}
+		else {
+			Format::for_each_attribute([&mesh, &uploads](auto attribute) {
+				typedef decltype(attribute) attribute_type;
+				gl_buffer& buffer = stream_buffer(mesh, attribute_type::stream);
+				if (attribute_type::stream & ~mesh.streams) {
+					buffer.reset();
+					return;
+				}
+				if (buffer == 0)
+					buffer = create_buffer();
+				glBindBuffer(GL_ARRAY_BUFFER, buffer);
+				attribute_type::pointer(0, 0);
+				const std::vector<unsigned char> packed = Format::template pack_attribute<attribute_type>(mesh.vertices);
+				mesh.upload_ticket = uploads.upload_buffer(buffer, packed.data(), packed.size());
+			});
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	image::image() : width(0), height(0), components(0), hash(0) {
 		// nop
 	}
 
-	material::material() : diffuse({ 0, 0, 0 }), specular({ 0, 0, 0 }), ambient({ 0, 0, 0 }), shininess(0) {
+	bool image::decode(const std::string& filepath) {
+		std::vector<char> bytes;
+		if (!read_file(filepath, bytes))
+			return false;
+		hash = hash_bytes(bytes.data(), bytes.size());
+		return decode(bytes);
+	}
+
+	bool image::decode(const std::vector<char>& bytes) {
+		return decode(reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size());
+	}
+
+	bool image::decode(const unsigned char* bytes, size_t size) {
+		stbi_set_flip_vertically_on_load_thread(true);
+		unsigned char* data = stbi_load_from_memory(bytes, int(size), &width, &height, &components, STBI_default);
+		if (data == NULL)
+			return false;
+		pixels.assign(data, data + size_t(width) * height * components);
+		stbi_image_free(data);
+		return components == 3 || components == 4;
+	}
+
+	image image::white() {
+		image result;
+		result.width = result.height = 1;
+		result.components = 3;
+		result.pixels = { 255, 255, 255 };
+		return result;
+	}
+
+	mesh::mesh(size_t vertices_size) : mesh_data(vertices_size), upload_ticket(0), streams(0), vertex_count(0), index_count(0), position_offset(0.0f), position_scale(1.0f),
+		texture_offset(0.0f), texture_scale(1.0f) {
 		// nop
 	}
 
-	mesh::mesh(size_t vertices_size) : vao(0), vertex_buffer(0), uv_buffer(0), normal_buffer(0), texture_id(0), vertices(vertices_size), material() {
+	mesh::mesh(mesh_data&& data) : mesh_data(std::move(data)), upload_ticket(0), streams(0), vertex_count(0), index_count(0), position_offset(0.0f), position_scale(1.0f),
+		texture_offset(0.0f), texture_scale(1.0f) {
 		// nop
 	}
 
-	void mesh::load_texture(const std::string& texture_name, const std::string texture_directory) {
-		int w, h;
-		int comp;
-
-		if (texture_name.length() > 0) {
-			const std::string texture_filepath = texture_directory + texture_name;
-			
-			stbi_set_flip_vertically_on_load(true); 
-			unsigned char* image = stbi_load(texture_filepath.c_str(), &w, &h, &comp, STBI_default);
-			if (image != NULL) {
-				glGenTextures(1, &texture_id);
-				glBindTexture(GL_TEXTURE_2D, texture_id);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-				if (comp == 3)
-					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-				else if (comp == 4)
-					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-				glBindTexture(GL_TEXTURE_2D, 0);
-				glGenerateMipmap(GL_TEXTURE_2D);
-				stbi_image_free(image);
+	void mesh::load_texture() {
+		if (texture_id != 0)
+			return;
+		texture_id.reset(asset_registry::instance().acquire_texture(texture_filepath));
+	}
 
-				return;
-			}
+	void mesh::bind_buffer() {
+		vao = create_vertex_array();
+		vertex_buffer = create_buffer();
+		update_buffer();
+	}
+
+	void mesh::update_buffer() {
+		mark_scene_changed();
+		streams = vertices.streams();
+		vertex_count = vertices.positions.size();
+		bounds.assign(vertices.positions);
+		occluder = build_occluder(vertices.positions, indices);
+		index_count = indices.size();
+
+		glBindVertexArray(vao);
+		if (buffer_layout == vertex_layout::interleaved)
+			upload_vertices<interleaved_format>(*this);
+		else if (buffer_layout == vertex_layout::compact)
+			upload_vertices<compact_format>(*this);
+		else
+			upload_vertices<separate_format>(*this);
+
+		upload_indices();
+		glBindVertexArray(0);
+	}
+
+	// with the vertex array bound
+	void mesh::upload_indices() {
+		if (indices.empty()) {
+			index_buffer.reset();
+			return;
 		}
 
-		unsigned char white[3] = { 255, 255, 255 };
-		glGenTextures(1, &texture_id);
-		glBindTexture(GL_TEXTURE_2D, texture_id);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, white);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		if (index_buffer == 0)
+			index_buffer = create_buffer();
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+		upload_ticket = upload_queue::instance().upload_buffer(index_buffer, indices.data(), sizeof(GLuint) * indices.size());
 	}
 
-	void mesh::bind_buffer() {
-		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
+	static unsigned quantized_streams(const quantized_vertex* vertices, size_t count) {
+		unsigned result = stream_quantized;
+		for (size_t i = 0; i < count; ++i) {
+			if (vertices[i].normal[0] != 0 || vertices[i].normal[1] != 0 || vertices[i].normal[2] != 0)
+				result |= stream_normals;
+			if (vertices[i].texture_coordinate != 0)
+				result |= stream_texture_coordinates;
+		}
+		return result;
+	}
+
+	void mesh::bind_buffer(const mapped_mesh& source, std::shared_ptr<const void> owner) {
+		mark_scene_changed();
+		vao = create_vertex_array();
+		vertex_buffer = create_buffer();
+		streams = quantized_streams(source.vertices, source.vertex_count);
+		vertex_count = source.vertex_count;
+		index_count = source.index_count;
+		// the shader reads unorm16 positions in [0, 1]
+		position_offset = source.offset;
+		position_scale = source.scale * 65535.0f;
+
+		// draws take 32-bit indices, so only 16-bit ones are widened
+		std::vector<std::uint32_t> widened;
+		const std::uint32_t* index_data = static_cast<const std::uint32_t*>(source.indices);
+		if (source.index_size == 2) {
+			const std::uint16_t* short_indices = static_cast<const std::uint16_t*>(source.indices);
+			widened.assign(short_indices, short_indices + index_count);
+			index_data = widened.data();
+		}
+
+		const std::vector<glm::vec3> positions = dequantize_positions(source.vertices, vertex_count, source.offset, source.scale);
+		bounds.assign(positions);
+		occluder = build_occluder(positions, std::vector<std::uint32_t>(index_data, index_data + index_count));
 
-		glGenBuffers(1, &vertex_buffer);
+		upload_queue& uploads = upload_queue::instance();
+		glBindVertexArray(vao);
 		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * vertices.positions.size(), &vertices.positions[0], GL_STATIC_DRAW);
-
-		glGenBuffers(1, &uv_buffer);
-		glBindBuffer(GL_ARRAY_BUFFER, uv_buffer);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec2) * vertices.texture_coordinates.size(), &vertices.texture_coordinates[0], GL_STATIC_DRAW);
-
-		glGenBuffers(1, &normal_buffer);
-		glBindBuffer(GL_ARRAY_BUFFER, normal_buffer);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * vertices.normals.size(), &vertices.normals[0], GL_STATIC_DRAW);
-	}
-
-	object::object(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, const std::vector<tinyobj::material_t>& materials, const std::string texture_directory) {
-		for (size_t s = 0; s < shapes.size(); s++) {
-			const size_t vertices_size = shapes[s].mesh.num_face_vertices.size() * 3;
-			mesh mesh(vertices_size);
-
-			size_t index_offset = 0;
-			for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-				size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
-
-				for (size_t v = 0; v < fv; v++) {
-					tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-					tinyobj::real_t vx = attrib.vertices[3 * size_t(idx.vertex_index) + 0];
-					tinyobj::real_t vy = attrib.vertices[3 * size_t(idx.vertex_index) + 1];
-					tinyobj::real_t vz = attrib.vertices[3 * size_t(idx.vertex_index) + 2];
-					mesh.vertices.positions[index_offset + v] = glm::vec3(vx, vy, vz);
-
-					if (idx.normal_index >= 0) {
-						tinyobj::real_t nx = attrib.normals[3 * size_t(idx.normal_index) + 0];
-						tinyobj::real_t ny = attrib.normals[3 * size_t(idx.normal_index) + 1];
-						tinyobj::real_t nz = attrib.normals[3 * size_t(idx.normal_index) + 2];
-						mesh.vertices.normals[index_offset + v] = glm::vec3(nx, ny, nz);
-					}
-
-					if (idx.texcoord_index >= 0) {
-						tinyobj::real_t tx = attrib.texcoords[2 * size_t(idx.texcoord_index) + 0];
-						tinyobj::real_t ty = attrib.texcoords[2 * size_t(idx.texcoord_index) + 1];
-						mesh.vertices.texture_coordinates[index_offset + v] = glm::vec2(tx, ty);
-					}
-				}
-				index_offset += fv;
+		set_vertex_layout_pointers(streams);
+		upload_ticket = uploads.upload_buffer(vertex_buffer, source.vertices, sizeof(quantized_vertex) * vertex_count, owner);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		if (index_count > 0) {
+			index_buffer = create_buffer();
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+			upload_ticket = widened.empty()
+				? uploads.upload_buffer(index_buffer, index_data, sizeof(std::uint32_t) * index_count, owner)
+				: uploads.upload_buffer(index_buffer, index_data, sizeof(std::uint32_t) * index_count);
+		}
+		glBindVertexArray(0);
+	}
+
+	void mesh::bind_buffer(const std::vector<mapped_attribute>& attributes, const std::vector<glm::vec3>& positions, std::shared_ptr<const void> owner) {
+		mark_scene_changed();
+		vao = create_vertex_array();
+		streams = 0;
+		for (const mapped_attribute& attribute : attributes)
+			streams |= attribute.stream;
+		vertex_count = positions.size();
+		index_count = indices.size();
+		bounds.assign(positions);
+		occluder = build_occluder(positions, indices);
+
+		upload_queue& uploads = upload_queue::instance();
+		glBindVertexArray(vao);
+		separate_format::enable(streams);
+		separate_format::for_each_attribute([this, &attributes, &uploads, &owner](auto attribute) {
+			typedef decltype(attribute) attribute_type;
+			const auto source = std::find_if(attributes.begin(), attributes.end(), [](const mapped_attribute& a) { return a.stream == attribute_type::stream; });
+			gl_buffer& buffer = stream_buffer(*this, attribute_type::stream);
+			if (source == attributes.end()) {
+				buffer.reset();
+				return;
 			}
+			buffer = create_buffer();
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			glVertexAttribPointer(attribute_type::location, source->components, source->type, source->normalized ? GL_TRUE : GL_FALSE, source->stride, 0);
+			upload_ticket = uploads.upload_buffer(buffer, source->data, source->size, owner);
+		});
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		upload_indices();
+		glBindVertexArray(0);
+	}
+
+	const std::vector<glm::vec3>* mesh::occluder_triangles() const {
+		if (!occluder.valid() || occluder.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return NULL;
+		const std::vector<glm::vec3>& triangles = occluder.get();
+		return triangles.empty() ? NULL : &triangles;
+	}
+
+	void mesh::release_vertices() {
+		vertices = obj_viewer::vertices(0);
+		indices = std::vector<GLuint>();
+	}
+
+	object::object(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, const std::vector<tinyobj::material_t>& materials, const std::string texture_directory)
+		: object(build_meshes(attrib, shapes, materials, texture_directory)) {
+		// nop
+	}
 
-			const int mat_idx = shapes[s].mesh.material_ids[0];
-			const auto& material = materials[mat_idx];
-			mesh.material.diffuse = { material.diffuse[0], material.diffuse[1], material.diffuse[2] };
-			mesh.material.specular = { material.specular[0], material.specular[1], material.specular[2] };
-			mesh.material.ambient = { material.ambient[0], material.ambient[1], material.ambient[2] };
-			mesh.material.shininess = material.shininess;
+	object::object(std::vector<mesh>&& meshes) : object(bind(std::move(meshes))) {
+		// nop
+	}
 
-			mesh.bind_buffer();
-			mesh.load_texture(material.diffuse_texname, texture_directory);
-			this->meshes.push_back(mesh);
+	object::object(std::shared_ptr<std::vector<mesh>> meshes) : meshes(std::move(meshes)), _vertices_released(false), _moved(false) {
+		fit();
+	}
+
+	// bounds are filled in while binding, and fit reads them; meshes the loader already bound keep their buffers
+	std::shared_ptr<std::vector<mesh>> object::bind(std::vector<mesh>&& meshes) {
+		for (auto& mesh : meshes) {
+			if (mesh.vao == 0)
+				mesh.bind_buffer();
+			mesh.load_texture();
 		}
+		return std::make_shared<std::vector<mesh>>(std::move(meshes));
+	}
+
+	object::~object() {
+		if (_moved)
+			moved_objects.erase(std::find(moved_objects.begin(), moved_objects.end(), this));
+	}
 
+	std::pair<glm::vec3, glm::vec3> object::measure() {
 		const auto minmax = this->minmax();
+		_center = (minmax.first + minmax.second) * 0.5f;
+		_radius = glm::length(minmax.second - minmax.first) * 0.5f;
+		return minmax;
+	}
+
+	void object::fit() {
+		const auto minmax = measure();
 
 		const float sx = 2.0f / (minmax.second.x - minmax.first.x);
 		const float sy = 2.0f / (minmax.second.y - minmax.first.y);
@@ -134,16 +390,160 @@ namespace obj_viewer {
 		_orientation = { 1.0f, 0.0f, 0.0f, 0.0f };
 	}
 
+	std::vector<mesh> object::build_meshes(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, const std::vector<tinyobj::material_t>& materials, const std::string texture_directory) {
+		std::vector<mesh_data> data = obj_viewer::build_meshes(attrib, shapes, materials, texture_directory);
+		std::vector<mesh> result;
+		result.reserve(data.size());
+		for (mesh_data& mesh : data)
+			result.emplace_back(std::move(mesh));
+		return result;
+	}
+
+	std::vector<std::string> object::reload(std::vector<mesh>&& new_meshes) {
+		std::vector<mesh>& meshes = *this->meshes;
+		std::vector<std::string> changed_textures;
+
+		if (meshes.size() > new_meshes.size()) {
+			meshes.erase(meshes.begin() + new_meshes.size(), meshes.end());
+			mark_scene_changed();
+		}
+
+		for (size_t i = 0; i < new_meshes.size(); ++i) {
+			mesh& new_mesh = new_meshes[i];
+
+			if (i == meshes.size()) {
+				new_mesh.bind_buffer();
+				new_mesh.load_texture();
+				meshes.push_back(std::move(new_mesh));
+				continue;
+			}
+
+			mesh& mesh = meshes[i];
+			if (!(mesh.vertices == new_mesh.vertices) || mesh.indices != new_mesh.indices) {
+				mesh.vertices = std::move(new_mesh.vertices);
+				mesh.indices = std::move(new_mesh.indices);
+				mesh.update_buffer();
+			}
+			if (!(mesh.material == new_mesh.material)) {
+				mesh.material = new_mesh.material;
+				mark_scene_changed();
+			}
+			if (mesh.texture_filepath != new_mesh.texture_filepath) {
+				mesh.texture_filepath = new_mesh.texture_filepath;
+				changed_textures.push_back(mesh.texture_filepath);
+			}
+		}
+		measure();
+		if (_vertices_released)
+			release_vertices();
+		return changed_textures;
+	}
+
+	std::vector<std::string> object::reload_materials(const std::vector<tinyobj::material_t>& materials) {
+		std::vector<std::string> changed_textures;
+		const std::string texture_directory = file_directory.substr(0, file_directory.find_last_of("/\\") + 1);
+
+		for (auto& mesh : *meshes) {
+			for (const auto& material : materials) {
+				if (material.name != mesh.material.name)
+					continue;
+
+				const obj_viewer::material reloaded(material);
+				if (!(mesh.material == reloaded)) {
+					mesh.material = reloaded;
+					mark_scene_changed();
+				}
+				const std::string texture_filepath = material.diffuse_texname.length() > 0 ? texture_directory + material.diffuse_texname : "";
+				if (mesh.texture_filepath != texture_filepath) {
+					mesh.texture_filepath = texture_filepath;
+					changed_textures.push_back(texture_filepath);
+				}
+				break;
+			}
+		}
+		return changed_textures;
+	}
+
+	void object::reload_texture(const std::string& texture_filepath, const image& image) {
+		asset_registry& registry = asset_registry::instance();
+		for (auto& mesh : *meshes) {
+			if (mesh.texture_filepath != texture_filepath)
+				continue;
+			mesh.texture_id.reset(registry.acquire_texture(image));
+			mark_scene_changed();
+		}
+	}
+
 	void object::scaling(float scale) {
 		_scale *= scale;
+		mark_moved();
 	}
 
 	void object::move(const glm::vec3& distance) {
 		_position += distance;
+		mark_moved();
 	}
 
 	void object::rotate(const glm::quat& rotation) {
 		_orientation = rotation * _orientation;
+		mark_moved();
+	}
+
+	void object::mark_moved() {
+		if (_moved)
+			return;
+		_moved = true;
+		moved_objects.push_back(this);
+	}
+
+	void object::release_vertices() {
+		_vertices_released = true;
+		for (auto& mesh : *meshes)
+			mesh.release_vertices();
+	}
+
+	void object::set_instances(std::vector<glm::mat4>&& transforms) {
+		instances = std::move(transforms);
+		if (instances.empty())
+			instance_buffer.reset();
+		else {
+			if (instance_buffer == 0)
+				instance_buffer = create_buffer();
+			glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * instances.size(), instances.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		measure();
+		mark_scene_changed();
+	}
+
+	void object::arrange_grid(size_t count) {
+		// spaced by a single copy, not by the grid the object may already be
+		bounding_volume single;
+		for (const mesh& m : *meshes)
+			single.merge(m.bounds);
+		const size_t side = size_t(std::ceil(std::sqrt(double(count))));
+		const float spacing = single.empty() ? 0.0f : glm::length(single.max - single.min) * 1.25f;
+		const float origin = (side - 1) * spacing * 0.5f;
+		std::vector<glm::mat4> transforms;
+		transforms.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			const glm::vec3 offset(float(i % side) * spacing - origin, 0.0f, float(i / side) * spacing - origin);
+			transforms.push_back(glm::translate(glm::mat4(1.0f), offset));
+		}
+		set_instances(std::move(transforms));
+
+		// keep the whole grid the size the single object was fitted to
+		_scale /= float(side);
+		_position /= float(side);
+	}
+
+	size_t object::instance_count() const {
+		return instances.empty() ? 1 : instances.size();
+	}
+
+	glm::mat4 object::model() const {
+		return glm::translate(glm::mat4(1.0f), _position) * glm::scale(glm::mat4(1.0f), _scale) * glm::toMat4(_orientation);
 	}
 
 	std::unique_ptr<glm::vec3> object::scale() const {
@@ -158,28 +558,28 @@ namespace obj_viewer {
 		return std::make_unique<glm::quat>(_orientation);
 	}
 
+	std::unique_ptr<glm::vec3> object::center() const {
+		return std::make_unique<glm::vec3>(_center);
+	}
+
+	float object::radius() const {
+		return _radius;
+	}
+
+	// spans every copy when the object is instanced
 	std::pair<glm::vec3, glm::vec3> object::minmax() const {
-		bool initialized = false;
-		std::pair<glm::vec3, glm::vec3> result;
-
-		for (const mesh m : meshes) {
-			for (const glm::vec3& point : m.vertices.positions) {
-				if (!initialized) {
-					initialized = true;
-					result.first.x = result.second.x = point.x;
-					result.first.y = result.second.y = point.y;
-					result.first.z = result.second.z = point.z;
-				}
-				else {
-					result.first.x = std::min(result.first.x, point.x);
-					result.first.y = std::min(result.first.y, point.y);
-					result.first.z = std::min(result.first.z, point.z);
-					result.second.x = std::max(result.second.x, point.x);
-					result.second.y = std::max(result.second.y, point.y);
-					result.second.z = std::max(result.second.z, point.z);
-				}
-			}
+		bounding_volume single;
+		for (const mesh& m : *meshes)
+			single.merge(m.bounds);
+		bounding_volume result;
+		if (instances.empty())
+			result = single;
+		else if (!single.empty()) {
+			for (const glm::mat4& instance : instances)
+				result.merge(single.transformed(instance));
 		}
-		return result;
+		if (result.empty())
+			return std::pair<glm::vec3, glm::vec3>(glm::vec3(0.0f), glm::vec3(0.0f));
+		return std::pair<glm::vec3, glm::vec3>(result.min, result.max);
 	}
 }
@@ -2,66 +2,156 @@
 
 #include <string> // string
 #include <vector> // vector
-#include <memory> // unique_ptr
+#include <memory> // unique_ptr shared_ptr
+#include <cstdint> // uint32_t uint64_t
+#include <future> // shared_future
 #include <GL/glew.h> // GLuint
+#include <glm/vec2.hpp> // vec2
 #include <glm/vec3.hpp> // vec3
+#include <glm/mat4x4.hpp> // mat4
 #include <glm/gtx/quaternion.hpp> // quat
-#include "tiny_obj_loader.h"
+#include "mesh_data.h" // mesh_data vertices material
+#include "gl_handle.h" // gl_buffer gl_vertex_array texture_reference
+#include "bounds.h" // bounding_volume
 
 namespace obj_viewer {
 
-	class vertices {
+	enum class vertex_layout { separate, interleaved, compact };
+
+	void set_vertex_layout(vertex_layout layout);
+	vertex_layout current_vertex_layout();
+	// meshes only get occluder proxies while this is on, set before they are loaded
+	void set_occluder_proxies(bool enabled);
+
+	// bumped whenever mesh geometry, materials or textures change
+	size_t scene_version();
+	void mark_scene_changed();
+
+	class object;
+	// objects whose transform changed since the last call
+	std::vector<object*> take_moved_objects();
+
+	class image {
 	public:
-		std::vector<glm::vec3> positions;
-		std::vector<glm::vec3> normals;
-		std::vector<glm::vec2> texture_coordinates;
+		int width;
+		int height;
+		int components;
+		std::uint64_t hash;
+		std::vector<unsigned char> pixels;
+
+		image();
+		bool decode(const std::string& filepath);
+		bool decode(const std::vector<char>& bytes);
+		bool decode(const unsigned char* bytes, size_t size);
 
-		vertices(size_t size);
+		static image white();
 	};
 
-	class material {
-	public:
-		glm::vec3 diffuse;
-		glm::vec3 specular;
-		glm::vec3 ambient;
-		float shininess;
+	class mapped_mesh;
 
-		material();
+	// a vertex stream read in place from a mapped file, in any format glVertexAttribPointer takes
+	class mapped_attribute {
+	public:
+		unsigned stream;
+		const void* data;
+		size_t size;
+		GLenum type;
+		GLint components;
+		bool normalized;
+		GLsizei stride;
 	};
 
-	class mesh {
+	class mesh : public mesh_data {
 	public:
-		GLuint vao;
-		GLuint vertex_buffer;
-		GLuint uv_buffer;
-		GLuint normal_buffer;
-		GLuint texture_id;
-		vertices vertices;
-		material material;
+		gl_vertex_array vao;
+		gl_buffer vertex_buffer;
+		gl_buffer uv_buffer;
+		gl_buffer normal_buffer;
+		gl_buffer color_buffer;
+		gl_buffer index_buffer;
+		texture_reference texture_id;
+		size_t upload_ticket;
+		unsigned streams;
+		size_t vertex_count;
+		size_t index_count;
+		// maps buffer positions to model space, identity unless the positions are quantized
+		glm::vec3 position_offset;
+		glm::vec3 position_scale;
+		// maps buffer texture coordinates to texture space, identity unless the file flips them
+		glm::vec2 texture_offset;
+		glm::vec2 texture_scale;
+		bounding_volume bounds;
+		// triangles rendered into the occlusion buffer, gathered on a worker and kept after the vertices are released
+		std::shared_future<std::vector<glm::vec3>> occluder;
 
 		mesh(size_t vertices_size);
-		void load_texture(const std::string& texture_name, const std::string texture_directory);
+		mesh(mesh_data&& data);
+		mesh(mesh&& other) = default;
+		mesh& operator=(mesh&& other) = default;
+		mesh(const mesh&) = delete;
+		mesh& operator=(const mesh&) = delete;
+		void load_texture();
 		void bind_buffer();
+		// uploads cached vertices as they are mapped, keeping owner alive until the upload is done
+		void bind_buffer(const mapped_mesh& source, std::shared_ptr<const void> owner);
+		// uploads each stream as it is mapped with the separate layout, indexed by the cpu side indices
+		void bind_buffer(const std::vector<mapped_attribute>& attributes, const std::vector<glm::vec3>& positions, std::shared_ptr<const void> owner);
+		void update_buffer();
+		void release_vertices();
+		// the occluder once it is gathered, NULL before that or when the mesh has none
+		const std::vector<glm::vec3>* occluder_triangles() const;
+
+	private:
+		void upload_indices();
 	};
 
 	class object {
 	public:
-		std::vector<mesh> meshes;
+		std::shared_ptr<std::vector<mesh>> meshes;
+		std::string file_directory;
+		std::vector<std::string> mtl_directories;
+		// model space transforms of every copy, empty when the object is drawn once
+		std::vector<glm::mat4> instances;
+		gl_buffer instance_buffer;
 
 		object(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, const std::vector<tinyobj::material_t>& materials, const std::string texture_directory);
+		object(std::vector<mesh>&& meshes);
+		object(std::shared_ptr<std::vector<mesh>> meshes);
+		~object();
+		static std::vector<mesh> build_meshes(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, const std::vector<tinyobj::material_t>& materials, const std::string texture_directory);
+		std::vector<std::string> reload(std::vector<mesh>&& new_meshes);
+		std::vector<std::string> reload_materials(const std::vector<tinyobj::material_t>& materials);
+		void reload_texture(const std::string& texture_filepath, const image& image);
 		void scaling(float scale);
 		void move(const glm::vec3& distance);
 		void rotate(const glm::quat& rotation);
+		void release_vertices();
+		void set_instances(std::vector<glm::mat4>&& transforms);
+		void arrange_grid(size_t count);
+		size_t instance_count() const;
+		glm::mat4 model() const;
 
 		std::unique_ptr<glm::vec3> scale() const;
 		std::unique_ptr<glm::vec3> position() const;
 		std::unique_ptr<glm::quat> orientation() const;
+		std::unique_ptr<glm::vec3> center() const;
+		float radius() const;
 
 	private:
+		friend std::vector<object*> take_moved_objects();
+
 		glm::vec3 _scale;
 		glm::vec3 _position;
 		glm::quat _orientation;
+		glm::vec3 _center;
+		float _radius;
+		bool _vertices_released;
+		bool _moved;
 
+		static std::shared_ptr<std::vector<mesh>> bind(std::vector<mesh>&& meshes);
+		void fit();
+		void mark_moved();
+		std::pair<glm::vec3, glm::vec3> measure();
 		std::pair<glm::vec3, glm::vec3> minmax() const;
 		int load_diffuse_texture(const tinyobj::material_t& material, const std::string texture_directory);
 	};
@@ -0,0 +1,251 @@
+#include "occlusion.h"
+
+#include <cmath> // floor ceil lround
+#include <algorithm> // min max sort fill
+#include <future> // future
+#include <glm/glm.hpp> // min max
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h> // _mm_*
+#define OCCLUSION_SSE
+#endif
+
+namespace obj_viewer {
+
+	static const int buffer_width = 256;
+	static const size_t triangle_budget = 16384;
+	// matches the near plane of the projection, geometry in front of it is clipped away
+	static const float near_w = 0.1f;
+	// half a pixel reaches the corners from the center, the rest absorbs rounding in the edge and depth equations
+	static const float pixel_reach = 0.5f + 1.0f / 256.0f;
+
+	occlusion_buffer::occlusion_buffer() : _width(0), _height(0) {
+		// nop
+	}
+
+	void occlusion_buffer::begin(int window_width, int window_height) {
+		_width = buffer_width;
+		_height = std::max(16, std::min(4 * buffer_width, int(std::lround(double(buffer_width) * window_height / std::max(window_width, 1)))));
+		_depth.assign(size_t(_width) * _height, 0.0f);
+		_triangles.clear();
+	}
+
+	void occlusion_buffer::render(std::vector<occluder>& occluders) {
+		std::sort(occluders.begin(), occluders.end(), [](const occluder& a, const occluder& b) { return a.size > b.size; });
+		size_t triangles = 0;
+		for (const occluder& occluder : occluders) {
+			const std::vector<glm::vec3>& vertices = *occluder.triangles;
+			triangles += vertices.size() / 3;
+			if (triangles > triangle_budget)
+				break;
+			for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+				const glm::vec4 corners[3] = {
+					occluder.clip * glm::vec4(vertices[i], 1.0f),
+					occluder.clip * glm::vec4(vertices[i + 1], 1.0f),
+					occluder.clip * glm::vec4(vertices[i + 2], 1.0f)
+				};
+				add(corners, 3);
+			}
+		}
+
+		const int bands = int(std::min<size_t>(_pool.size(), size_t(_height / 8)));
+		std::vector<std::future<void>> done;
+		for (int band = 0; band < bands; ++band) {
+			const int first_row = _height * band / bands;
+			const int last_row = _height * (band + 1) / bands;
+			done.push_back(_pool.submit([this, first_row, last_row]() { rasterize(first_row, last_row); }));
+		}
+		for (auto& band : done)
+			band.get();
+	}
+
+	void occlusion_buffer::add(const glm::vec4* corners, size_t count) {
+		// triangles entirely outside one side of the frustum are dropped before clipping
+		for (int axis = 0; axis < 2; ++axis) {
+			if (corners[0][axis] > corners[0].w && corners[1][axis] > corners[1].w && corners[2][axis] > corners[2].w)
+				return;
+			if (corners[0][axis] < -corners[0].w && corners[1][axis] < -corners[1].w && corners[2][axis] < -corners[2].w)
+				return;
+		}
+
+		// clip the polygon against the near plane, a triangle gains at most one corner
+		glm::vec4 clipped[4];
+		size_t clipped_count = 0;
+		for (size_t i = 0; i < count; ++i) {
+			const glm::vec4& a = corners[i];
+			const glm::vec4& b = corners[(i + 1) % count];
+			const bool a_inside = a.w >= near_w;
+			const bool b_inside = b.w >= near_w;
+			if (a_inside)
+				clipped[clipped_count++] = a;
+			if (a_inside != b_inside)
+				clipped[clipped_count++] = a + (b - a) * ((near_w - a.w) / (b.w - a.w));
+		}
+		for (size_t i = 2; i < clipped_count; ++i)
+			add_triangle(clipped[0], clipped[i - 1], clipped[i]);
+	}
+
+	void occlusion_buffer::add_triangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+		const glm::vec4 clip[3] = { a, b, c };
+		screen_triangle triangle;
+		for (int i = 0; i < 3; ++i) {
+			const float inverse_w = 1.0f / clip[i].w;
+			triangle.vertices[i] = glm::vec3((clip[i].x * inverse_w * 0.5f + 0.5f) * _width, (clip[i].y * inverse_w * 0.5f + 0.5f) * _height, inverse_w);
+		}
+
+		const glm::vec3* v = triangle.vertices;
+		const float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+		if (std::abs(area) < 1e-8f)
+			return;
+		if (area < 0.0f)
+			std::swap(triangle.vertices[1], triangle.vertices[2]);
+
+		const float min_x = std::min({ v[0].x, v[1].x, v[2].x });
+		const float max_x = std::max({ v[0].x, v[1].x, v[2].x });
+		const float min_y = std::min({ v[0].y, v[1].y, v[2].y });
+		const float max_y = std::max({ v[0].y, v[1].y, v[2].y });
+		if (max_x < 0.0f || min_x > float(_width))
+			return;
+		triangle.min_row = std::max(0, int(std::ceil(min_y - 0.5f)));
+		triangle.max_row = std::min(_height - 1, int(std::floor(max_y - 0.5f)));
+		if (triangle.min_row <= triangle.max_row)
+			_triangles.push_back(triangle);
+	}
+
+	void occlusion_buffer::rasterize(int first_row, int last_row) {
+		for (const screen_triangle& triangle : _triangles) {
+			const int row_begin = std::max(first_row, triangle.min_row);
+			const int row_end = std::min(last_row - 1, triangle.max_row);
+			if (row_begin > row_end)
+				continue;
+
+			// edge functions e(x, y) = a x + b y + c are non-negative inside, the opposite corner weighs each
+			const glm::vec3* v = triangle.vertices;
+			float edge_a[3], edge_b[3], edge_c[3];
+			for (int e = 0; e < 3; ++e) {
+				const glm::vec3& p = v[e];
+				const glm::vec3& q = v[(e + 1) % 3];
+				edge_a[e] = p.y - q.y;
+				edge_b[e] = q.x - p.x;
+				edge_c[e] = (q.y - p.y) * p.x - (q.x - p.x) * p.y;
+			}
+			const float area = edge_c[0] + edge_a[0] * v[2].x + edge_b[0] * v[2].y;
+			// edge e is opposite corner (e + 2) % 3
+			float depth_a = 0.0f, depth_b = 0.0f, depth_c = 0.0f;
+			for (int e = 0; e < 3; ++e) {
+				const float z = v[(e + 2) % 3].z / area;
+				depth_a += edge_a[e] * z;
+				depth_b += edge_b[e] * z;
+				depth_c += edge_c[e] * z;
+			}
+
+			// conservative for culling: a pixel center passes only when the whole pixel square is inside every edge,
+			// and it takes the smallest 1 / w of the triangle over that square. 1 / w is affine in screen space,
+			// so both extremes sit at a corner and are the center value moved by the reach along each axis
+			for (int e = 0; e < 3; ++e)
+				edge_c[e] -= pixel_reach * (std::abs(edge_a[e]) + std::abs(edge_b[e]));
+			depth_c -= pixel_reach * (std::abs(depth_a) + std::abs(depth_b));
+
+			const float min_x = std::min({ v[0].x, v[1].x, v[2].x });
+			const float max_x = std::max({ v[0].x, v[1].x, v[2].x });
+			const int column_begin = std::max(0, int(std::floor(min_x - 0.5f))) & ~3;
+			const int column_end = std::min(_width - 1, int(std::ceil(max_x - 0.5f)));
+
+			for (int row = row_begin; row <= row_end; ++row) {
+				const float y = row + 0.5f;
+				float* depth = &_depth[size_t(row) * _width];
+				int column = column_begin;
+#if defined(OCCLUSION_SSE)
+				const __m128 zero = _mm_setzero_ps();
+				const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+				__m128 a[3], row_c[3];
+				for (int e = 0; e < 3; ++e) {
+					a[e] = _mm_set1_ps(edge_a[e]);
+					row_c[e] = _mm_set1_ps(edge_b[e] * y + edge_c[e]);
+				}
+				const __m128 za = _mm_set1_ps(depth_a);
+				const __m128 zc = _mm_set1_ps(depth_b * y + depth_c);
+				for (; column <= column_end; column += 4) {
+					const __m128 x = _mm_add_ps(_mm_set1_ps(float(column)), offsets);
+					__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[0], x), row_c[0]), zero);
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[1], x), row_c[1]), zero));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[2], x), row_c[2]), zero));
+					if (_mm_movemask_ps(inside) == 0)
+						continue;
+					const __m128 z = _mm_add_ps(_mm_mul_ps(za, x), zc);
+					const __m128 old = _mm_loadu_ps(depth + column);
+					const __m128 nearest = _mm_max_ps(old, z);
+					_mm_storeu_ps(depth + column, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+				}
+#endif
+				for (; column <= column_end; ++column) {
+					const float x = column + 0.5f;
+					bool inside = true;
+					for (int e = 0; e < 3; ++e)
+						inside = inside && edge_a[e] * x + edge_b[e] * y + edge_c[e] >= 0.0f;
+					if (inside)
+						depth[column] = std::max(depth[column], depth_a * x + depth_b * y + depth_c);
+				}
+			}
+		}
+	}
+
+	bool occlusion_buffer::occluded(const glm::vec3& min, const glm::vec3& max, const glm::mat4& clip) const {
+		if (_triangles.empty())
+			return false;
+
+		float min_x = float(_width), max_x = 0.0f, min_y = float(_height), max_y = 0.0f, nearest = 0.0f;
+		for (int corner = 0; corner < 8; ++corner) {
+			const glm::vec3 p((corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z);
+			const glm::vec4 c = clip * glm::vec4(p, 1.0f);
+			// boxes reaching the near plane are never hidden
+			if (c.w < near_w)
+				return false;
+			const float inverse_w = 1.0f / c.w;
+			const float x = (c.x * inverse_w * 0.5f + 0.5f) * _width;
+			const float y = (c.y * inverse_w * 0.5f + 0.5f) * _height;
+			min_x = std::min(min_x, x);
+			max_x = std::max(max_x, x);
+			min_y = std::min(min_y, y);
+			max_y = std::max(max_y, y);
+			nearest = std::max(nearest, inverse_w);
+		}
+
+		// every pixel the box may touch, widened to whole groups of four, must hold a nearer occluder
+		const int column_begin = std::max(0, int(std::floor(min_x))) & ~3;
+		const int column_end = std::min(_width - 1, int(std::ceil(max_x)));
+		const int row_begin = std::max(0, int(std::floor(min_y)));
+		const int row_end = std::min(_height - 1, int(std::ceil(max_y)));
+		if (column_begin > column_end || row_begin > row_end)
+			return false;
+
+		for (int row = row_begin; row <= row_end; ++row) {
+			const float* depth = &_depth[size_t(row) * _width];
+			int column = column_begin;
+#if defined(OCCLUSION_SSE)
+			const __m128 box = _mm_set1_ps(nearest);
+			for (; column + 3 <= column_end; column += 4) {
+				if (_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(depth + column), box)) != 0)
+					return false;
+			}
+#endif
+			for (; column <= column_end; ++column) {
+				if (depth[column] <= nearest)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	int occlusion_buffer::width() const {
+		return _width;
+	}
+
+	int occlusion_buffer::height() const {
+		return _height;
+	}
+
+	const std::vector<float>& occlusion_buffer::depth() const {
+		return _depth;
+	}
+}
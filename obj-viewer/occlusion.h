@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector> // vector
+#include <glm/vec3.hpp> // vec3
+#include <glm/mat4x4.hpp> // mat4
+#include "thread_pool.h" // thread_pool
+
+namespace obj_viewer {
+
+	class occluder {
+	public:
+		const std::vector<glm::vec3>* triangles;
+		// maps the triangles' model space to clip space
+		glm::mat4 clip;
+		// rough screen size, larger occluders are rendered first
+		float size;
+	};
+
+	// low resolution depth buffer of the largest occluders, rasterized on the cpu four pixels at a time
+	// by several threads each owning a band of rows. it stores 1 / w, so larger values are nearer.
+	// a pixel only takes triangles covering all of it, at the farthest depth they reach inside it, so
+	// whatever the buffer says is hidden really is, at the cost of losing occluder edges
+	class occlusion_buffer {
+	public:
+		occlusion_buffer();
+		// clears the buffer, its height follows the aspect ratio of the window
+		void begin(int window_width, int window_height);
+		// renders occluders from the largest down until the triangle budget runs out
+		void render(std::vector<occluder>& occluders);
+		// whether the box, in the model space clip maps from, is behind the rendered occluders everywhere it covers
+		bool occluded(const glm::vec3& min, const glm::vec3& max, const glm::mat4& clip) const;
+
+		int width() const;
+		int height() const;
+		const std::vector<float>& depth() const;
+
+	private:
+		class screen_triangle {
+		public:
+			glm::vec3 vertices[3];
+			int min_row;
+			int max_row;
+		};
+
+		std::vector<float> _depth;
+		std::vector<screen_triangle> _triangles;
+		int _width;
+		int _height;
+		thread_pool _pool;
+
+		void add(const glm::vec4* clipped, size_t count);
+		void add_triangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+		void rasterize(int first_row, int last_row);
+	};
+}
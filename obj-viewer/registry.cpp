@@ -0,0 +1,410 @@
+#include "registry.h"
+
+#include <iostream> // cerr
+#include <cmath> // floor log2
+#include <algorithm> // min max sort
+#include "upload.h" // upload_queue
+
+namespace obj_viewer {
+
+	static const int stream_base_size = 64;
+	static const size_t stream_budget = 8 << 20;
+	static const int array_max_size = 256;
+
+	asset_registry::asset_registry() : _compression(block_format::none), _texture_budget(0), _max_texture_size(0), _frame(0), _bindings_version(0) {
+		// nop
+	}
+
+	asset_registry& asset_registry::instance() {
+		static asset_registry* instance = new asset_registry();
+		return *instance;
+	}
+
+	std::shared_ptr<std::vector<mesh>> asset_registry::find_meshes(std::uint64_t hash) const {
+		const auto found = _meshes.find(hash);
+		if (found == _meshes.end())
+			return nullptr;
+		return found->second.lock();
+	}
+
+	void asset_registry::add_meshes(std::uint64_t hash, const std::shared_ptr<std::vector<mesh>>& meshes) {
+		_meshes[hash] = meshes;
+	}
+
+	void asset_registry::remove_meshes(const std::shared_ptr<std::vector<mesh>>& meshes) {
+		for (auto it = _meshes.begin(); it != _meshes.end();) {
+			if (it->second.expired() || it->second.lock() == meshes)
+				it = _meshes.erase(it);
+			else
+				++it;
+		}
+	}
+
+	// keyed by path until the decoder thread has read and hashed the file, see resolve_texture
+	GLuint asset_registry::acquire_texture(const std::string& texture_filepath) {
+		if (texture_filepath.empty())
+			return acquire_texture(image::white());
+		const std::uint64_t hash = hash_bytes(texture_filepath.data(), texture_filepath.size(), ~std::uint64_t(_max_texture_size));
+		const auto resolved = _texture_paths.find(hash);
+		const GLuint texture_id = acquire_texture(resolved != _texture_paths.end() ? resolved->second : hash);
+		if (texture_id != 0)
+			return texture_id;
+
+		texture_entry& entry = create_texture(hash);
+		upload_texture(entry.texture_id, image::white());
+		entry.filepath = texture_filepath;
+		entry.max_size = _max_texture_size;
+		entry.decoding = true;
+		_decoder.decode(hash, texture_filepath, _compression, entry.max_size);
+		return entry.texture_id;
+	}
+
+	GLuint asset_registry::acquire_texture(const void* data, size_t size, std::shared_ptr<const void> owner) {
+		const std::uint64_t hash = hash_bytes(data, size, std::uint64_t(_max_texture_size));
+		const GLuint texture_id = acquire_texture(hash);
+		if (texture_id != 0)
+			return texture_id;
+
+		texture_entry& entry = create_texture(hash);
+		upload_texture(entry.texture_id, image::white());
+		entry.source_owner = std::move(owner);
+		entry.source = data;
+		entry.source_size = size;
+		entry.max_size = _max_texture_size;
+		entry.decoding = true;
+		_decoder.decode(hash, entry.source, entry.source_size, entry.source_owner, _compression, entry.max_size);
+		return entry.texture_id;
+	}
+
+	// the cap is part of the key only when it shrinks the image, so small images and white share entries
+	GLuint asset_registry::acquire_texture(const image& image) {
+		const bool capped = _max_texture_size > 0 && std::max(image.width, image.height) > _max_texture_size;
+		const std::uint64_t hash = capped ? hash_bytes(&image.hash, sizeof(image.hash), std::uint64_t(_max_texture_size)) : image.hash;
+		const GLuint texture_id = acquire_texture(hash);
+		if (texture_id != 0)
+			return texture_id;
+
+		texture_entry& entry = create_texture(hash);
+		upload_texture(entry.texture_id, image::white());
+		entry.max_size = _max_texture_size;
+		entry.decoding = true;
+		_decoder.decode(hash, obj_viewer::image(image), _compression, entry.max_size);
+		return entry.texture_id;
+	}
+
+	GLuint asset_registry::acquire_texture(std::uint64_t hash) {
+		const auto found = _textures.find(hash);
+		if (found == _textures.end())
+			return 0;
+		found->second.references++;
+		return found->second.texture_id;
+	}
+
+	asset_registry::texture_entry& asset_registry::create_texture(std::uint64_t hash) {
+		texture_entry& entry = _textures[hash];
+		entry.references = 1;
+		glGenTextures(1, &entry.texture_id);
+		_texture_hashes[entry.texture_id] = hash;
+		return entry;
+	}
+
+	// moves a path keyed entry under the hash of its content, or folds it into the entry already
+	// there, which then answers for both names and carries both reference counts
+	bool asset_registry::resolve_texture(std::map<std::uint64_t, texture_entry>::iterator& found, std::uint64_t content_hash) {
+		_texture_paths[found->first] = content_hash;
+		const auto existing = _textures.find(content_hash);
+		if (existing == _textures.end()) {
+			auto node = _textures.extract(found);
+			node.key() = content_hash;
+			found = _textures.insert(std::move(node)).position;
+			_texture_hashes[found->second.texture_id] = content_hash;
+			return true;
+		}
+
+		texture_entry& shared = existing->second;
+		shared.references += found->second.references;
+		shared.aliases.push_back(found->second.texture_id);
+		_texture_hashes[found->second.texture_id] = content_hash;
+		_textures.erase(found);
+		++_bindings_version;
+		return false;
+	}
+
+	bool asset_registry::pack_texture(texture_entry& entry) {
+		if (std::max(entry.levels[0].width, entry.levels[0].height) > array_max_size)
+			return false;
+
+		size_t array = 0;
+		while (array < _arrays.size() && !_arrays[array].accepts(entry.levels, entry.compressed))
+			++array;
+		if (array == _arrays.size())
+			_arrays.emplace_back(entry.levels, entry.compressed);
+
+		std::vector<const unsigned char*> data;
+		for (size_t level = 0; level < entry.levels.size(); ++level)
+			data.push_back(entry.level_pointer(level));
+		entry.array = int(array);
+		entry.layer = _arrays[array].add(entry.levels, data);
+		++_bindings_version;
+		entry.clear_levels();
+		entry.resident = entry.coarse = 0;
+		release_texture_level(entry.texture_id, 0);
+		return true;
+	}
+
+	void asset_registry::release_texture(GLuint texture_id) {
+		const auto found = _texture_hashes.find(texture_id);
+		if (found == _texture_hashes.end())
+			return;
+		const auto it = _textures.find(found->second);
+		if (--it->second.references > 0)
+			return;
+
+		texture_entry& entry = it->second;
+		if (entry.array >= 0)
+			_arrays[entry.array].remove(entry.layer);
+		upload_queue::instance().cancel_texture(entry.texture_id);
+		entry.aliases.push_back(entry.texture_id);
+		for (GLuint name : entry.aliases)
+			_texture_hashes.erase(name);
+		glDeleteTextures(GLsizei(entry.aliases.size()), entry.aliases.data());
+		for (auto path = _texture_paths.begin(); path != _texture_paths.end();) {
+			if (path->second == it->first)
+				path = _texture_paths.erase(path);
+			else
+				++path;
+		}
+		_textures.erase(it);
+	}
+
+	texture_binding asset_registry::request_texture(GLuint texture_id, float pixels) {
+		const auto found = _texture_hashes.find(texture_id);
+		if (found == _texture_hashes.end())
+			return texture_binding(texture_id, -1);
+
+		texture_entry& entry = _textures.find(found->second)->second;
+		entry.requested = std::max(entry.requested, pixels);
+		entry.last_visible = _frame;
+		if (entry.array >= 0)
+			return texture_binding(_arrays[entry.array].texture_id, entry.layer);
+		return texture_binding(entry.texture_id, -1);
+	}
+
+	texture_binding asset_registry::find_binding(GLuint texture_id) const {
+		const auto found = _texture_hashes.find(texture_id);
+		if (found == _texture_hashes.end())
+			return texture_binding(texture_id, -1);
+
+		const texture_entry& entry = _textures.find(found->second)->second;
+		if (entry.array >= 0)
+			return texture_binding(_arrays[entry.array].texture_id, entry.layer);
+		return texture_binding(entry.texture_id, -1);
+	}
+
+	size_t asset_registry::bindings_version() const {
+		return _bindings_version;
+	}
+
+	bool asset_registry::is_white_texture(GLuint texture_id) const {
+		const auto found = _texture_hashes.find(texture_id);
+		return found != _texture_hashes.end() && found->second == image::white().hash;
+	}
+
+	void asset_registry::update_textures() {
+		for (decoded_texture& texture : _decoder.finished()) {
+			auto found = _textures.find(texture.hash);
+			if (found == _textures.end())
+				continue;
+			if (texture.content_hash != 0 && texture.content_hash != texture.hash && !resolve_texture(found, texture.content_hash))
+				continue;
+
+			texture_entry& entry = found->second;
+			entry.decoding = false;
+			if (texture.levels.empty())
+				continue;
+			entry.levels = std::move(texture.levels);
+			entry.compressed = std::move(texture.compressed);
+			entry.mapping = std::move(texture.mapping);
+			entry.level_data = std::move(texture.level_data);
+			const size_t count = entry.levels.size();
+
+			if (!entry.level_bytes.empty()) {
+				for (size_t level = entry.resident; level < count; ++level) {
+					entry.levels[level].pixels = std::vector<unsigned char>();
+					if (!entry.compressed.empty())
+						entry.compressed[level].blocks = std::vector<unsigned char>();
+				}
+				continue;
+			}
+
+			entry.measure_levels();
+			if (pack_texture(entry))
+				continue;
+
+			size_t base = count - 1;
+			while (base > 0 && std::max(entry.levels[base - 1].width, entry.levels[base - 1].height) <= stream_base_size)
+				--base;
+			for (size_t level = count; level-- > base;)
+				entry.upload_level(level);
+			entry.resident = entry.coarse = base;
+			entry.size = float(std::max(entry.levels[0].width, entry.levels[0].height));
+		}
+		stream_textures();
+		++_frame;
+	}
+
+	void asset_registry::stream_textures() {
+		const upload_queue& uploads = upload_queue::instance();
+		size_t used = 0;
+		for (auto& texture : _textures) {
+			texture_entry& entry = texture.second;
+			used += entry.resident_bytes();
+			if (entry.array < 0 && !entry.level_bytes.empty() && entry.sampled != entry.resident && uploads.ready(entry.upload_ticket)) {
+				set_texture_levels(entry.texture_id, entry.resident, entry.level_bytes.size());
+				entry.sampled = entry.resident;
+			}
+		}
+
+		size_t budget = stream_budget;
+		for (auto& texture : _textures) {
+			texture_entry& entry = texture.second;
+			const float requested = entry.requested;
+			entry.requested = 0.0f;
+			if (entry.level_bytes.empty() || entry.resident == 0 || requested <= 0.0f || budget == 0)
+				continue;
+
+			const size_t wanted = size_t(std::max(0.0f, std::floor(std::log2(entry.size / requested))));
+
+			while (entry.resident > wanted && budget > 0) {
+				const size_t level = entry.resident - 1;
+				if (!entry.has_level(level)) {
+					if (!entry.decoding && !entry.filepath.empty()) {
+						entry.decoding = true;
+						_decoder.decode(texture.first, entry.filepath, _compression, entry.max_size);
+					}
+					else if (!entry.decoding && entry.source != NULL) {
+						entry.decoding = true;
+						_decoder.decode(texture.first, entry.source, entry.source_size, entry.source_owner, _compression, entry.max_size);
+					}
+					break;
+				}
+
+				const size_t bytes = entry.level_bytes[level];
+				if (_texture_budget > 0 && used + bytes > _texture_budget && !evict_textures(used + bytes - _texture_budget, used))
+					break;
+				entry.upload_level(level);
+				entry.resident = level;
+				used += bytes;
+				budget -= std::min(budget, bytes);
+			}
+
+			if (entry.resident == 0)
+				entry.clear_levels();
+		}
+	}
+
+	bool asset_registry::evict_textures(size_t bytes, size_t& used) {
+		std::vector<texture_entry*> candidates;
+		for (auto& texture : _textures) {
+			texture_entry& entry = texture.second;
+			const bool reloadable = !entry.filepath.empty() || entry.source != NULL;
+			if (reloadable && entry.resident < entry.coarse && entry.sampled == entry.resident && _frame - entry.last_visible > 1)
+				candidates.push_back(&entry);
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const texture_entry* a, const texture_entry* b) {
+			return a->last_visible < b->last_visible;
+		});
+
+		size_t freed = 0;
+		for (texture_entry* entry : candidates) {
+			while (freed < bytes && entry->resident < entry->coarse) {
+				freed += entry->level_bytes[entry->resident];
+				entry->evict_level();
+			}
+			set_texture_levels(entry->texture_id, entry->resident, entry->level_bytes.size());
+			entry->sampled = entry->resident;
+			if (freed >= bytes)
+				break;
+		}
+		used -= std::min(used, freed);
+		return freed >= bytes;
+	}
+
+	asset_registry::texture_entry::texture_entry() : texture_id(0), references(0), source(NULL), source_size(0), resident(0), coarse(0), sampled(0), upload_ticket(0), size(0.0f), requested(0.0f), last_visible(0), decoding(false), max_size(0), array(-1), layer(-1) {
+		// nop
+	}
+
+	void asset_registry::texture_entry::measure_levels() {
+		level_bytes.clear();
+		for (size_t level = 0; level < levels.size(); ++level) {
+			const image& image = levels[level];
+			level_bytes.push_back(texture_level_bytes(image.width, image.height, image.components, compressed.empty() ? block_format::none : compressed[level].format));
+		}
+	}
+
+	bool asset_registry::texture_entry::has_level(size_t level) const {
+		if (level >= levels.size())
+			return false;
+		if (mapping)
+			return true;
+		return compressed.empty() ? !levels[level].pixels.empty() : !compressed[level].blocks.empty();
+	}
+
+	const unsigned char* asset_registry::texture_entry::level_pointer(size_t level) const {
+		if (mapping)
+			return level_data[level];
+		return compressed.empty() ? levels[level].pixels.data() : compressed[level].blocks.data();
+	}
+
+	void asset_registry::texture_entry::clear_levels() {
+		levels.clear();
+		compressed.clear();
+		mapping.reset();
+		level_data.clear();
+	}
+
+	size_t asset_registry::texture_entry::resident_bytes() const {
+		size_t bytes = 0;
+		for (size_t level = resident; level < level_bytes.size(); ++level)
+			bytes += level_bytes[level];
+		return bytes;
+	}
+
+	void asset_registry::texture_entry::upload_level(size_t level) {
+		upload_queue& uploads = upload_queue::instance();
+		if (mapping && !compressed.empty())
+			upload_ticket = uploads.upload_texture_level(texture_id, level, compressed[level], level_data[level], mapping);
+		else if (mapping)
+			upload_ticket = uploads.upload_texture_level(texture_id, level, levels[level], level_data[level], mapping);
+		else if (!compressed.empty())
+			upload_ticket = uploads.upload_texture_level(texture_id, level, std::move(compressed[level]));
+		else
+			upload_ticket = uploads.upload_texture_level(texture_id, level, std::move(levels[level]));
+		levels[level].pixels = std::vector<unsigned char>();
+	}
+
+	void asset_registry::texture_entry::evict_level() {
+		release_texture_level(texture_id, resident);
+		++resident;
+	}
+
+	void asset_registry::set_texture_budget(size_t bytes) {
+		_texture_budget = bytes;
+	}
+
+	void asset_registry::set_max_texture_size(int max_size) {
+		_max_texture_size = max_size;
+	}
+
+	void asset_registry::set_texture_cache(const std::string& directory) {
+		_decoder.set_cache_directory(directory);
+	}
+
+	void asset_registry::set_texture_compression(block_format compression) {
+		if ((compression == block_format::bc1 || compression == block_format::bc3 || compression == block_format::automatic) && !GLEW_EXT_texture_compression_s3tc) {
+			std::cerr << "S3TC texture compression is not supported, textures stay uncompressed\n";
+			compression = block_format::none;
+		}
+		_compression = compression;
+	}
+}
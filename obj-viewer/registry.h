@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include <map> // map
+#include <memory> // shared_ptr weak_ptr
+#include <cstdint> // uint64_t
+#include <GL/glew.h> // GLuint
+#include "object.h" // mesh image
+#include "texture.h" // texture_decoder
+#include "mapped_file.h" // hash_bytes read_file
+
+namespace obj_viewer {
+
+	class asset_registry {
+	public:
+		static asset_registry& instance();
+
+		std::shared_ptr<std::vector<mesh>> find_meshes(std::uint64_t hash) const;
+		void add_meshes(std::uint64_t hash, const std::shared_ptr<std::vector<mesh>>& meshes);
+		void remove_meshes(const std::shared_ptr<std::vector<mesh>>& meshes);
+
+		GLuint acquire_texture(const std::string& texture_filepath);
+		// data stays readable through owner, typically the mapped model file
+		GLuint acquire_texture(const void* data, size_t size, std::shared_ptr<const void> owner);
+		GLuint acquire_texture(const image& image);
+		void release_texture(GLuint texture_id);
+		texture_binding request_texture(GLuint texture_id, float pixels);
+		texture_binding find_binding(GLuint texture_id) const;
+		// bumped whenever a texture moves into or out of an array layer
+		size_t bindings_version() const;
+		bool is_white_texture(GLuint texture_id) const;
+		void update_textures();
+		void set_texture_compression(block_format compression);
+		void set_texture_budget(size_t bytes);
+		void set_max_texture_size(int max_size);
+		void set_texture_cache(const std::string& directory);
+
+	private:
+		class texture_entry {
+		public:
+			GLuint texture_id;
+			int references;
+			// where the encoded image is decoded from again when evicted mips come back, either a
+			// file or an image embedded in a mapped model, which the system pages in from disk
+			std::string filepath;
+			std::shared_ptr<const void> source_owner;
+			const void* source;
+			size_t source_size;
+			std::vector<image> levels;
+			std::vector<compressed_image> compressed;
+			// set while the levels are read in place from a mapped disk cache file
+			std::shared_ptr<const void> mapping;
+			std::vector<const unsigned char*> level_data;
+			std::vector<size_t> level_bytes;
+			size_t resident;
+			size_t coarse;
+			size_t sampled;
+			size_t upload_ticket;
+			float size;
+			float requested;
+			size_t last_visible;
+			bool decoding;
+			int max_size;
+			int array;
+			GLint layer;
+			// placeholder names handed out by path before the decoder found this content under them
+			std::vector<GLuint> aliases;
+
+			texture_entry();
+			void measure_levels();
+			bool has_level(size_t level) const;
+			const unsigned char* level_pointer(size_t level) const;
+			void clear_levels();
+			size_t resident_bytes() const;
+			void upload_level(size_t level);
+			void evict_level();
+		};
+
+		std::map<std::uint64_t, std::weak_ptr<std::vector<mesh>>> _meshes;
+		std::map<std::uint64_t, texture_entry> _textures;
+		std::map<GLuint, std::uint64_t> _texture_hashes;
+		// path keys whose file content turned out to be known under its content hash
+		std::map<std::uint64_t, std::uint64_t> _texture_paths;
+		std::vector<texture_array> _arrays;
+		texture_decoder _decoder;
+		block_format _compression;
+		size_t _texture_budget;
+		int _max_texture_size;
+		size_t _frame;
+		size_t _bindings_version;
+
+		asset_registry();
+		GLuint acquire_texture(std::uint64_t hash);
+		texture_entry& create_texture(std::uint64_t hash);
+		bool resolve_texture(std::map<std::uint64_t, texture_entry>::iterator& found, std::uint64_t content_hash);
+		bool pack_texture(texture_entry& entry);
+		void stream_textures();
+		bool evict_textures(size_t bytes, size_t& used);
+	};
+}
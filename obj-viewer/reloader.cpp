@@ -0,0 +1,195 @@
+#include "reloader.h"
+
+#include <iostream> // cout
+#include <algorithm> // find
+#include <chrono> // seconds
+#include <set> // set
+#include "loader.h" // parse_obj parse_mtl
+#include "registry.h" // asset_registry
+
+namespace obj_viewer {
+
+	static const int poll_interval = 500;
+
+	template <typename T>
+	static bool ready(const std::future<T>& future) {
+		return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	void file_watcher::watch(const std::string& filepath) {
+		if (filepath.empty() || _files.count(filepath) > 0)
+			return;
+
+		std::error_code error;
+		_files[filepath] = std::filesystem::last_write_time(filepath, error);
+	}
+
+	std::vector<std::string> file_watcher::poll() {
+		std::vector<std::string> changed;
+		for (auto& file : _files) {
+			std::error_code error;
+			const auto time = std::filesystem::last_write_time(file.first, error);
+			if (error || time == file.second)
+				continue;
+			file.second = time;
+			changed.push_back(file.first);
+		}
+		return changed;
+	}
+
+	reloader::reloader() : _last_poll(0) {
+		// nop
+	}
+
+	void reloader::track(object& obj) {
+		if (obj.file_directory.empty())
+			return;
+		_objs.push_back(&obj);
+		watch(obj);
+	}
+
+	void reloader::update(int time) {
+		apply();
+
+		if (time - _last_poll < poll_interval)
+			return;
+		_last_poll = time;
+
+		for (const std::string& filepath : _watcher.poll()) {
+			std::cout << "reload:" << filepath << '\n';
+			bool is_obj = false;
+			bool is_mtl = false;
+			std::set<const std::vector<mesh>*> scheduled;
+
+			for (object* obj : _objs) {
+				if (obj->file_directory == filepath) {
+					is_obj = true;
+					if (scheduled.insert(obj->meshes.get()).second)
+						reload_obj(*obj);
+				}
+				else if (std::find(obj->mtl_directories.begin(), obj->mtl_directories.end(), filepath) != obj->mtl_directories.end()) {
+					is_mtl = true;
+				}
+			}
+
+			if (is_mtl)
+				reload_mtl(filepath);
+			else if (!is_obj)
+				reload_textures({ filepath });
+		}
+	}
+
+	void reloader::watch(const object& obj) {
+		_watcher.watch(obj.file_directory);
+		for (const auto& mtl_directory : obj.mtl_directories)
+			_watcher.watch(mtl_directory);
+		for (const auto& mesh : *obj.meshes)
+			_watcher.watch(mesh.texture_filepath);
+	}
+
+	void reloader::reload_obj(object& obj) {
+		const std::string filepath = obj.file_directory;
+		const std::string texture_directory = filepath.substr(0, filepath.find_last_of("/\\") + 1);
+		_pending_objs.emplace_back(&obj, std::async(std::launch::async, [filepath, texture_directory]() {
+			obj_file file;
+			if (!parse_obj(filepath, file))
+				return std::unique_ptr<reloaded_obj>();
+			auto result = std::make_unique<reloaded_obj>();
+			result->meshes = object::build_meshes(file.attrib, file.shapes, file.materials, texture_directory);
+			result->mtl_directories = std::move(file.mtl_directories);
+			return result;
+		}));
+	}
+
+	void reloader::reload_mtl(const std::string& mtl_directory) {
+		_pending_mtls.emplace_back(mtl_directory, std::async(std::launch::async, [mtl_directory]() {
+			auto materials = std::make_unique<std::vector<tinyobj::material_t>>();
+			if (!parse_mtl(mtl_directory, *materials))
+				materials.reset();
+			return materials;
+		}));
+	}
+
+	void reloader::reload_textures(const std::vector<std::string>& texture_filepaths) {
+		for (const std::string& filepath : texture_filepaths) {
+			_watcher.watch(filepath);
+			_pending_textures.emplace_back(filepath, std::async(std::launch::async, [filepath]() {
+				if (filepath.empty())
+					return std::make_unique<image>(image::white());
+				auto result = std::make_unique<image>();
+				if (!result->decode(filepath))
+					result.reset();
+				return result;
+			}));
+		}
+	}
+
+	void reloader::apply() {
+		for (auto it = _pending_objs.begin(); it != _pending_objs.end();) {
+			if (!ready(it->second)) {
+				++it;
+				continue;
+			}
+
+			std::unique_ptr<reloaded_obj> reloaded = it->second.get();
+			object* obj = it->first;
+			it = _pending_objs.erase(it);
+			if (!reloaded)
+				continue;
+
+			asset_registry::instance().remove_meshes(obj->meshes);
+			const bool shared = std::any_of(_objs.begin(), _objs.end(), [obj](const object* other) {
+				return other->meshes == obj->meshes && other->file_directory != obj->file_directory;
+			});
+			if (shared)
+				obj->meshes = std::make_shared<std::vector<mesh>>();
+
+			for (object* other : _objs) {
+				if (other->meshes == obj->meshes)
+					other->mtl_directories = reloaded->mtl_directories;
+			}
+			reload_textures(obj->reload(std::move(reloaded->meshes)));
+			watch(*obj);
+		}
+
+		for (auto it = _pending_mtls.begin(); it != _pending_mtls.end();) {
+			if (!ready(it->second)) {
+				++it;
+				continue;
+			}
+
+			std::unique_ptr<std::vector<tinyobj::material_t>> materials = it->second.get();
+			const std::string mtl_directory = it->first;
+			it = _pending_mtls.erase(it);
+			if (!materials)
+				continue;
+
+			std::set<const std::vector<mesh>*> reloaded;
+			for (object* obj : _objs) {
+				if (std::find(obj->mtl_directories.begin(), obj->mtl_directories.end(), mtl_directory) == obj->mtl_directories.end())
+					continue;
+				if (reloaded.insert(obj->meshes.get()).second)
+					reload_textures(obj->reload_materials(*materials));
+			}
+		}
+
+		for (auto it = _pending_textures.begin(); it != _pending_textures.end();) {
+			if (!ready(it->second)) {
+				++it;
+				continue;
+			}
+
+			std::unique_ptr<image> image = it->second.get();
+			const std::string texture_filepath = it->first;
+			it = _pending_textures.erase(it);
+			if (!image)
+				continue;
+
+			std::set<const std::vector<mesh>*> reloaded;
+			for (object* obj : _objs) {
+				if (reloaded.insert(obj->meshes.get()).second)
+					obj->reload_texture(texture_filepath, *image);
+			}
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include <map> // map
+#include <memory> // unique_ptr
+#include <future> // future
+#include <filesystem> // file_time_type
+#include "object.h" // object image
+
+namespace obj_viewer {
+
+	class file_watcher {
+	public:
+		void watch(const std::string& filepath);
+		std::vector<std::string> poll();
+
+	private:
+		std::map<std::string, std::filesystem::file_time_type> _files;
+	};
+
+	class reloader {
+	public:
+		reloader();
+
+		void track(object& obj);
+		void update(int time);
+
+	private:
+		class reloaded_obj {
+		public:
+			std::vector<mesh> meshes;
+			std::vector<std::string> mtl_directories;
+		};
+
+		int _last_poll;
+		file_watcher _watcher;
+		std::vector<object*> _objs;
+		std::vector<std::pair<object*, std::future<std::unique_ptr<reloaded_obj>>>> _pending_objs;
+		std::vector<std::pair<std::string, std::future<std::unique_ptr<std::vector<tinyobj::material_t>>>>> _pending_mtls;
+		std::vector<std::pair<std::string, std::future<std::unique_ptr<image>>>> _pending_textures;
+
+		void watch(const object& obj);
+		void reload_obj(object& obj);
+		void reload_mtl(const std::string& mtl_directory);
+		void reload_textures(const std::vector<std::string>& texture_filepaths);
+		void apply();
+	};
+}
@@ -0,0 +1,334 @@
+#include "scan_loader.h"
+
+#include <cstring> // memcpy memcmp memchr
+#include <cstdint> // uint8_t uint16_t uint32_t
+#include <sstream> // istringstream
+#include <iostream> // cerr
+#include <algorithm> // reverse min search
+#include "geometry.h" // compute_normals
+
+namespace obj_viewer {
+
+	enum class ply_type { none, int8, uint8, int16, uint16, int32, uint32, float32, float64 };
+
+	class ply_property {
+	public:
+		std::string name;
+		ply_type type;
+		ply_type count_type;
+		size_t offset;
+	};
+
+	class ply_element {
+	public:
+		std::string name;
+		size_t count;
+		size_t stride;
+		bool fixed;
+		std::vector<ply_property> properties;
+
+		const ply_property* find(const std::string& name) const {
+			for (const auto& property : properties) {
+				if (property.name == name)
+					return &property;
+			}
+			return NULL;
+		}
+	};
+
+	static ply_type parse_ply_type(const std::string& name) {
+		if (name == "char" || name == "int8") return ply_type::int8;
+		if (name == "uchar" || name == "uint8") return ply_type::uint8;
+		if (name == "short" || name == "int16") return ply_type::int16;
+		if (name == "ushort" || name == "uint16") return ply_type::uint16;
+		if (name == "int" || name == "int32") return ply_type::int32;
+		if (name == "uint" || name == "uint32") return ply_type::uint32;
+		if (name == "float" || name == "float32") return ply_type::float32;
+		if (name == "double" || name == "float64") return ply_type::float64;
+		return ply_type::none;
+	}
+
+	static size_t ply_type_size(ply_type type) {
+		switch (type) {
+		case ply_type::int8: case ply_type::uint8: return 1;
+		case ply_type::int16: case ply_type::uint16: return 2;
+		case ply_type::int32: case ply_type::uint32: case ply_type::float32: return 4;
+		case ply_type::float64: return 8;
+		default: return 0;
+		}
+	}
+
+	template <typename T>
+	static T load(const unsigned char* data, bool swap) {
+		unsigned char bytes[sizeof(T)];
+		memcpy(bytes, data, sizeof(T));
+		if (swap)
+			std::reverse(bytes, bytes + sizeof(T));
+		T value;
+		memcpy(&value, bytes, sizeof(T));
+		return value;
+	}
+
+	static double read_ply_value(const unsigned char* data, ply_type type, bool swap) {
+		switch (type) {
+		case ply_type::int8: return double(load<std::int8_t>(data, swap));
+		case ply_type::uint8: return double(load<std::uint8_t>(data, swap));
+		case ply_type::int16: return double(load<std::int16_t>(data, swap));
+		case ply_type::uint16: return double(load<std::uint16_t>(data, swap));
+		case ply_type::int32: return double(load<std::int32_t>(data, swap));
+		case ply_type::uint32: return double(load<std::uint32_t>(data, swap));
+		case ply_type::float32: return double(load<float>(data, swap));
+		case ply_type::float64: return load<double>(data, swap);
+		default: return 0.0;
+		}
+	}
+
+	static std::uint32_t read_ply_index(const unsigned char* data, ply_type type, bool swap) {
+		switch (type) {
+		case ply_type::int8: case ply_type::uint8: return *data;
+		case ply_type::int16: case ply_type::uint16: return load<std::uint16_t>(data, swap);
+		case ply_type::int32: case ply_type::uint32: return load<std::uint32_t>(data, swap);
+		default: return std::uint32_t(read_ply_value(data, type, swap));
+		}
+	}
+
+	bool is_ply(const mapped_file& file) {
+		return file.size() >= 4 && memcmp(file.data(), "ply", 3) == 0 && (file.data()[3] == '\n' || file.data()[3] == '\r');
+	}
+
+	bool is_binary_stl(const mapped_file& file) {
+		if (file.size() < 84)
+			return false;
+		const std::uint32_t count = load<std::uint32_t>(file.data() + 80, false);
+		return file.size() == 84 + size_t(count) * 50;
+	}
+
+	// advances p past one property, false when the property runs past end
+	static bool skip_ply_property(const ply_property& property, const unsigned char*& p, const unsigned char* end, bool swap) {
+		size_t size = ply_type_size(property.type);
+		if (property.count_type != ply_type::none) {
+			const size_t count_size = ply_type_size(property.count_type);
+			if (size_t(end - p) < count_size)
+				return false;
+			size = count_size + size_t(read_ply_index(p, property.count_type, swap)) * size;
+		}
+		if (size_t(end - p) < size)
+			return false;
+		p += size;
+		return true;
+	}
+
+	static bool skip_ply_element(const ply_element& element, const unsigned char*& data, const unsigned char* end, bool swap) {
+		if (element.fixed) {
+			if (element.stride != 0 && size_t(end - data) / element.stride < element.count)
+				return false;
+			data += element.count * element.stride;
+			return true;
+		}
+
+		for (size_t i = 0; i < element.count; ++i) {
+			for (const auto& property : element.properties) {
+				if (!skip_ply_property(property, data, end, swap))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	static void read_ply_vertices(const ply_element& element, const unsigned char* data, bool swap, vertices& vertices) {
+		const ply_property* x = element.find("x");
+		const ply_property* y = element.find("y");
+		const ply_property* z = element.find("z");
+		const ply_property* nx = element.find("nx");
+		const ply_property* ny = element.find("ny");
+		const ply_property* nz = element.find("nz");
+		const ply_property* u = element.find("u") ? element.find("u") : element.find("s") ? element.find("s") : element.find("texture_u");
+		const ply_property* v = element.find("v") ? element.find("v") : element.find("t") ? element.find("t") : element.find("texture_v");
+		const size_t stride = element.stride;
+
+		const bool packed_floats = !swap && x->type == ply_type::float32 && y->type == ply_type::float32 && z->type == ply_type::float32
+			&& y->offset == x->offset + 4 && z->offset == x->offset + 8;
+		if (packed_floats) {
+			for (size_t i = 0; i < element.count; ++i)
+				memcpy(&vertices.positions[i], data + i * stride + x->offset, sizeof(glm::vec3));
+		}
+		else {
+			for (size_t i = 0; i < element.count; ++i) {
+				const unsigned char* vertex = data + i * stride;
+				vertices.positions[i] = glm::vec3(read_ply_value(vertex + x->offset, x->type, swap), read_ply_value(vertex + y->offset, y->type, swap), read_ply_value(vertex + z->offset, z->type, swap));
+			}
+		}
+
+		if (nx && ny && nz) {
+			for (size_t i = 0; i < element.count; ++i) {
+				const unsigned char* vertex = data + i * stride;
+				vertices.normals[i] = glm::vec3(read_ply_value(vertex + nx->offset, nx->type, swap), read_ply_value(vertex + ny->offset, ny->type, swap), read_ply_value(vertex + nz->offset, nz->type, swap));
+			}
+		}
+
+		if (u && v) {
+			for (size_t i = 0; i < element.count; ++i) {
+				const unsigned char* vertex = data + i * stride;
+				vertices.texture_coordinates[i] = glm::vec2(read_ply_value(vertex + u->offset, u->type, swap), read_ply_value(vertex + v->offset, v->type, swap));
+			}
+		}
+	}
+
+	// reads the faces and advances data past the element in the same pass
+	static bool read_ply_faces(const ply_element& element, const unsigned char*& data, const unsigned char* end, bool swap, size_t vertex_count, std::vector<GLuint>& indices) {
+		const ply_property* list = element.find("vertex_indices") ? element.find("vertex_indices") : element.find("vertex_index");
+		if (list == NULL || list->count_type == ply_type::none || list->type == ply_type::none)
+			return false;
+
+		const size_t count_size = ply_type_size(list->count_type);
+		const size_t index_size = ply_type_size(list->type);
+		indices.reserve(element.count * 3);
+
+		const unsigned char* p = data;
+		for (size_t f = 0; f < element.count; ++f) {
+			for (const auto& property : element.properties) {
+				if (&property != list) {
+					if (!skip_ply_property(property, p, end, swap))
+						return false;
+					continue;
+				}
+
+				if (size_t(end - p) < count_size)
+					return false;
+				const std::uint32_t count = read_ply_index(p, list->count_type, swap);
+				p += count_size;
+				if (size_t(end - p) / index_size < count)
+					return false;
+
+				const std::uint32_t first = count > 0 ? read_ply_index(p, list->type, swap) : 0;
+				for (std::uint32_t k = 2; k < count; ++k) {
+					const std::uint32_t second = read_ply_index(p + (k - 1) * index_size, list->type, swap);
+					const std::uint32_t third = read_ply_index(p + k * index_size, list->type, swap);
+					if (first >= vertex_count || second >= vertex_count || third >= vertex_count)
+						continue;
+					indices.push_back(first);
+					indices.push_back(second);
+					indices.push_back(third);
+				}
+				p += count * index_size;
+			}
+		}
+		data = p;
+		return true;
+	}
+
+	bool read_ply(const mapped_file& file, std::vector<mesh>& meshes) {
+		const char* text = reinterpret_cast<const char*>(file.data());
+		const char* header_limit = text + std::min<size_t>(file.size(), 1 << 16);
+		const char* end_header = "end_header";
+		const char* header_end = std::search(text, header_limit, end_header, end_header + 10);
+		if (!is_ply(file) || header_end == header_limit)
+			return false;
+		const char* body = static_cast<const char*>(memchr(header_end, '\n', file.size() - (header_end - text)));
+		if (body == NULL)
+			return false;
+
+		std::istringstream header(std::string(text, header_end));
+		std::string line;
+		std::string format;
+		std::vector<ply_element> elements;
+		while (std::getline(header, line)) {
+			std::istringstream words(line);
+			std::string keyword;
+			words >> keyword;
+			if (keyword == "format") {
+				words >> format;
+			}
+			else if (keyword == "element") {
+				ply_element element = { "", 0, 0, true, {} };
+				words >> element.name >> element.count;
+				elements.push_back(element);
+			}
+			else if (keyword == "property" && !elements.empty()) {
+				ply_element& element = elements.back();
+				ply_property property = { "", ply_type::none, ply_type::none, element.stride };
+				std::string type;
+				words >> type;
+				if (type == "list") {
+					std::string count_type, item_type;
+					words >> count_type >> item_type;
+					property.count_type = parse_ply_type(count_type);
+					property.type = parse_ply_type(item_type);
+					element.fixed = false;
+				}
+				else {
+					property.type = parse_ply_type(type);
+					element.stride += ply_type_size(property.type);
+				}
+				words >> property.name;
+				element.properties.push_back(property);
+			}
+		}
+
+		if (format != "binary_little_endian" && format != "binary_big_endian") {
+			std::cerr << "PLY: unsupported format [" << format << "]\n";
+			return false;
+		}
+		const bool swap = format == "binary_big_endian";
+
+		const unsigned char* data = reinterpret_cast<const unsigned char*>(body + 1);
+		const unsigned char* end = file.data() + file.size();
+		mesh mesh(0);
+		mesh.material = material::white();
+		bool has_normals = false;
+
+		for (const auto& element : elements) {
+			if (element.name == "vertex") {
+				const unsigned char* vertex_data = data;
+				if (!element.fixed || !element.find("x") || !element.find("y") || !element.find("z") || !skip_ply_element(element, data, end, swap))
+					return false;
+				mesh.vertices = vertices(element.count);
+				read_ply_vertices(element, vertex_data, swap, mesh.vertices);
+				has_normals = element.find("nx") != NULL;
+			}
+			else if (element.name == "face") {
+				if (!read_ply_faces(element, data, end, swap, mesh.vertices.positions.size(), mesh.indices))
+					return false;
+			}
+			else if (!skip_ply_element(element, data, end, swap))
+				return false;
+		}
+
+		if (!has_normals)
+			compute_normals(mesh.vertices, mesh.indices);
+		meshes.push_back(std::move(mesh));
+		return true;
+	}
+
+	bool read_stl(const mapped_file& file, std::vector<mesh>& meshes) {
+		if (!is_binary_stl(file)) {
+			std::cerr << "STL: only binary STL is supported\n";
+			return false;
+		}
+
+		const size_t count = load<std::uint32_t>(file.data() + 80, false);
+		const unsigned char* data = file.data() + 84;
+		mesh mesh(count * 3);
+		mesh.material = material::white();
+
+		for (size_t t = 0; t < count; ++t) {
+			const unsigned char* triangle = data + t * 50;
+			glm::vec3 normal;
+			memcpy(&normal, triangle, sizeof(glm::vec3));
+			memcpy(&mesh.vertices.positions[t * 3], triangle + 12, sizeof(glm::vec3) * 3);
+
+			if (normal == glm::vec3(0.0f)) {
+				const glm::vec3* p = &mesh.vertices.positions[t * 3];
+				normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+				const float length = glm::length(normal);
+				normal = length > 0.0f ? normal / length : normal;
+			}
+			mesh.vertices.normals[t * 3 + 0] = normal;
+			mesh.vertices.normals[t * 3 + 1] = normal;
+			mesh.vertices.normals[t * 3 + 2] = normal;
+		}
+
+		meshes.push_back(std::move(mesh));
+		return true;
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include "object.h" // mesh
+#include "mapped_file.h" // mapped_file
+
+namespace obj_viewer {
+
+	bool is_ply(const mapped_file& file);
+	bool is_binary_stl(const mapped_file& file);
+
+	bool read_ply(const mapped_file& file, std::vector<mesh>& meshes);
+	bool read_stl(const mapped_file& file, std::vector<mesh>& meshes);
+}
@@ -0,0 +1,209 @@
+#include "stats.h"
+
+#include <chrono> // steady_clock
+#include <map> // map
+#include <iomanip> // setprecision
+#include <sstream> // ostringstream
+#include <cstdio> // snprintf
+#include <thread> // thread
+#include "loader.h" // obj_file read_obj_file parse_obj
+#include "geometry.h" // repair weld optimize_vertex_cache acmr
+#include "bcn.h" // compress decompress psnr
+#include "stb_image.h" // stbi_info
+
+namespace obj_viewer {
+
+	static const size_t acmr_cache_size = 32;
+
+	class stopwatch {
+	public:
+		stopwatch() : _start(std::chrono::steady_clock::now()) {
+			// nop
+		}
+
+		double lap() {
+			const auto now = std::chrono::steady_clock::now();
+			const std::chrono::duration<double, std::milli> elapsed = now - _start;
+			_start = now;
+			return elapsed.count();
+		}
+
+	private:
+		std::chrono::steady_clock::time_point _start;
+	};
+
+	static std::string quote(const std::string& text) {
+		std::string result = "\"";
+		for (const char c : text) {
+			if (c == '"' || c == '\\') {
+				result += '\\';
+				result += c;
+			}
+			else if (static_cast<unsigned char>(c) < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				result += escaped;
+			}
+			else {
+				result += c;
+			}
+		}
+		return result + "\"";
+	}
+
+	static size_t vertex_bytes(size_t count) {
+		return count * (sizeof(glm::vec3) * 2 + sizeof(glm::vec2));
+	}
+
+	static size_t parsed_bytes(const obj_file& file) {
+		size_t bytes = sizeof(tinyobj::real_t) * (file.attrib.vertices.size() + file.attrib.normals.size() + file.attrib.texcoords.size() + file.attrib.colors.size());
+		for (const auto& shape : file.shapes) {
+			bytes += sizeof(tinyobj::index_t) * shape.mesh.indices.size();
+			bytes += sizeof(unsigned char) * shape.mesh.num_face_vertices.size();
+			bytes += sizeof(int) * (shape.mesh.material_ids.size() + shape.mesh.smoothing_group_ids.size());
+		}
+		return bytes;
+	}
+
+	static void print_file_stats(const std::string& file_directory, std::ostream& out) {
+		stopwatch watch;
+		stopwatch total;
+		std::map<std::string, double> times;
+
+		obj_file file;
+		if (!read_obj_file(file_directory, file)) {
+			out << "{ \"file\": " << quote(file_directory) << ", \"error\": \"cannot read file\" }";
+			return;
+		}
+		const size_t file_bytes = file.obj_text.size() + file.mtl_text.size();
+		times["read"] = watch.lap();
+
+		if (!parse_obj(file)) {
+			out << "{ \"file\": " << quote(file_directory) << ", \"error\": \"cannot parse file\" }";
+			return;
+		}
+		times["parse"] = watch.lap();
+		const size_t parse_bytes = parsed_bytes(file);
+
+		std::vector<mesh> meshes = object::build_meshes(file.attrib, file.shapes, file.materials, file.path);
+		times["expand"] = watch.lap();
+
+		size_t expanded_bytes = 0;
+		size_t indexed_bytes = 0;
+		size_t total_vertices = 0;
+		size_t total_faces = 0;
+		std::vector<std::string> mesh_stats;
+		double repair_time = 0, weld_time = 0, optimize_time = 0;
+
+		for (size_t m = 0; m < meshes.size(); ++m) {
+			vertices& vertices = meshes[m].vertices;
+			const size_t expanded = vertices.positions.size();
+			expanded_bytes += vertex_bytes(expanded);
+			total_vertices += expanded;
+			total_faces += expanded / 3;
+
+			watch.lap();
+			const size_t degenerate = repair(vertices);
+			repair_time += watch.lap();
+			std::vector<std::uint32_t> indices = weld(vertices);
+			weld_time += watch.lap();
+			const float source_acmr = acmr(indices, acmr_cache_size);
+			watch.lap();
+			optimize_vertex_cache(indices, vertices.positions.size());
+			optimize_vertex_fetch(vertices, indices);
+			optimize_time += watch.lap();
+
+			const size_t unique = vertices.positions.size();
+			const size_t indexed = vertex_bytes(unique) + sizeof(std::uint32_t) * indices.size();
+			indexed_bytes += indexed;
+
+			std::ostringstream stats;
+			stats << "{ \"name\": " << quote(file.shapes[m].name)
+				<< ", \"material\": " << quote(meshes[m].material.name)
+				<< ", \"texture\": " << quote(meshes[m].texture_filepath)
+				<< ", \"faces\": " << expanded / 3
+				<< ", \"vertices\": " << expanded
+				<< ", \"unique_vertices\": " << unique
+				<< ", \"duplicate_vertex_ratio\": " << (expanded > 0 ? 1.0 - double(unique) / expanded : 0.0)
+				<< ", \"degenerate_faces\": " << degenerate
+				<< ", \"acmr\": " << source_acmr
+				<< ", \"acmr_optimized\": " << acmr(indices, acmr_cache_size)
+				<< ", \"bytes\": { \"expanded\": " << vertex_bytes(expanded) << ", \"indexed\": " << indexed << " } }";
+			mesh_stats.push_back(stats.str());
+		}
+		times["repair"] = repair_time;
+		times["weld"] = weld_time;
+		times["optimize"] = optimize_time;
+
+		std::map<std::string, size_t> textures;
+		for (const auto& mesh : meshes) {
+			if (!mesh.texture_filepath.empty())
+				textures[mesh.texture_filepath] = 0;
+		}
+
+		size_t texture_bytes = 0;
+		std::vector<std::string> texture_stats;
+		for (auto& texture : textures) {
+			int width = 0, height = 0, components = 0;
+			const bool valid = stbi_info(texture.first.c_str(), &width, &height, &components) != 0;
+			const size_t bytes = size_t(width) * height * components * 4 / 3;
+			texture_bytes += bytes;
+
+			std::ostringstream stats;
+			stats << "{ \"file\": " << quote(texture.first) << ", \"valid\": " << (valid ? "true" : "false")
+				<< ", \"width\": " << width << ", \"height\": " << height << ", \"components\": " << components
+				<< ", \"gpu_bytes\": " << bytes << ", \"compression\": [";
+
+			image decoded;
+			if (valid && decoded.decode(texture.first)) {
+				const block_format formats[] = { block_format::bc1, block_format::bc3, block_format::bc5 };
+				for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+					watch.lap();
+					const compressed_image compressed = compress(decoded, formats[f], std::thread::hardware_concurrency());
+					const double time = watch.lap();
+					stats << (f > 0 ? ", " : "") << "{ \"format\": " << quote(block_format_name(formats[f]))
+						<< ", \"time_ms\": " << time << ", \"psnr\": " << psnr(decoded, decompress(compressed), formats[f])
+						<< ", \"gpu_bytes\": " << compressed.blocks.size() * 4 / 3 << " }";
+				}
+			}
+			stats << "] }";
+			texture_stats.push_back(stats.str());
+		}
+		times["total"] = total.lap();
+
+		out << "{ \"file\": " << quote(file_directory) << ",\n";
+		out << "      \"vertices\": " << total_vertices << ", \"faces\": " << total_faces << ", \"mesh_count\": " << meshes.size() << ",\n";
+		out << "      \"bytes\": { \"file\": " << file_bytes << ", \"parsed\": " << parse_bytes << ", \"expanded\": " << expanded_bytes
+			<< ", \"indexed\": " << indexed_bytes << ", \"gpu_vertices\": " << expanded_bytes << ", \"gpu_textures\": " << texture_bytes << " },\n";
+		out << "      \"time_ms\": { ";
+		const char* phases[] = { "read", "parse", "expand", "repair", "weld", "optimize", "total" };
+		for (size_t p = 0; p < sizeof(phases) / sizeof(phases[0]); ++p)
+			out << (p > 0 ? ", " : "") << quote(phases[p]) << ": " << times[phases[p]];
+		out << " },\n";
+
+		out << "      \"materials\": [";
+		for (size_t i = 0; i < file.materials.size(); ++i)
+			out << (i > 0 ? ", " : "") << quote(file.materials[i].name);
+		out << "],\n";
+
+		out << "      \"textures\": [";
+		for (size_t i = 0; i < texture_stats.size(); ++i)
+			out << (i > 0 ? "," : "") << "\n        " << texture_stats[i];
+		out << (texture_stats.empty() ? "" : "\n      ") << "],\n";
+
+		out << "      \"meshes\": [";
+		for (size_t i = 0; i < mesh_stats.size(); ++i)
+			out << (i > 0 ? "," : "") << "\n        " << mesh_stats[i];
+		out << (mesh_stats.empty() ? "" : "\n      ") << "] }";
+	}
+
+	void print_stats(const std::vector<std::string>& file_directories, std::ostream& out) {
+		out << std::setprecision(6);
+		out << "{\n  \"acmr_cache_size\": " << acmr_cache_size << ",\n  \"files\": [";
+		for (size_t i = 0; i < file_directories.size(); ++i) {
+			out << (i > 0 ? "," : "") << "\n    ";
+			print_file_stats(file_directories[i], out);
+		}
+		out << "\n  ]\n}\n";
+	}
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include <ostream> // ostream
+
+namespace obj_viewer {
+
+	void print_stats(const std::vector<std::string>& file_directories, std::ostream& out);
+}
@@ -0,0 +1,394 @@
+#include "texture.h"
+
+#include <iostream> // cout cerr
+#include <algorithm> // max
+#include <filesystem> // last_write_time
+#include <system_error> // error_code
+#include "mipmap.h" // build_mip_chain
+#include "texture_cache.h" // read_texture_cache write_texture_cache
+#include "mapped_file.h" // read_file hash_bytes
+
+namespace obj_viewer {
+
+	static const size_t texture_cache_budget = size_t(1) << 30;
+
+	static void set_sampling(size_t base_level, size_t levels) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, GLint(base_level));
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(levels > 0 ? levels - 1 : 0));
+	}
+
+	static void tex_image(size_t level, const image& image, const void* data) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		if (image.components == 3)
+			glTexImage2D(GL_TEXTURE_2D, GLint(level), GL_RGB, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+		else if (image.components == 4)
+			glTexImage2D(GL_TEXTURE_2D, GLint(level), GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
+	static void tex_image(size_t level, const image& image) {
+		tex_image(level, image, image.pixels.data());
+	}
+
+	GLenum compressed_internal_format(block_format format) {
+		if (format == block_format::bc3)
+			return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		if (format == block_format::bc5)
+			return GL_COMPRESSED_RG_RGTC2;
+		return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	}
+
+	size_t texture_level_bytes(int width, int height, int components, block_format format) {
+		if (format != block_format::none)
+			return size_t((width + 3) / 4) * ((height + 3) / 4) * (format == block_format::bc1 ? 8 : 16);
+		return size_t(width) * height * components;
+	}
+
+	static void tex_image(size_t level, const compressed_image& image, const void* data) {
+		const size_t size = texture_level_bytes(image.width, image.height, 0, image.format);
+		glCompressedTexImage2D(GL_TEXTURE_2D, GLint(level), compressed_internal_format(image.format), image.width, image.height, 0, GLsizei(size), data);
+	}
+
+	static void tex_image(size_t level, const compressed_image& image) {
+		tex_image(level, image, image.blocks.data());
+	}
+
+	// a single level, meant for placeholders; full chains are built by the decoder
+	void upload_texture(GLuint texture_id, const image& image) {
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		set_sampling(0, 1);
+		tex_image(0, image);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void upload_texture(GLuint texture_id, const std::vector<image>& levels) {
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		set_sampling(0, levels.size());
+		for (size_t level = 0; level < levels.size(); ++level)
+			tex_image(level, levels[level]);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void upload_texture(GLuint texture_id, const std::vector<compressed_image>& levels) {
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		set_sampling(0, levels.size());
+		for (size_t level = 0; level < levels.size(); ++level)
+			tex_image(level, levels[level]);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void upload_texture_level(GLuint texture_id, size_t level, const image& image) {
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		tex_image(level, image);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void upload_texture_level(GLuint texture_id, size_t level, const compressed_image& image) {
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		tex_image(level, image);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void upload_texture_level(GLuint texture_id, size_t level, const image& image, const void* data) {
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		tex_image(level, image, data);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void upload_texture_level(GLuint texture_id, size_t level, const compressed_image& image, const void* data) {
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		tex_image(level, image, data);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void release_texture_level(GLuint texture_id, size_t level) {
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		glTexImage2D(GL_TEXTURE_2D, GLint(level), GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void set_texture_levels(GLuint texture_id, size_t base_level, size_t levels) {
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		set_sampling(base_level, levels);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	texture_binding::texture_binding(GLuint texture_id, GLint layer) : texture_id(texture_id), layer(layer) {
+		// nop
+	}
+
+	bool texture_binding::operator<(const texture_binding& other) const {
+		return texture_id != other.texture_id ? texture_id < other.texture_id : layer < other.layer;
+	}
+
+	bool texture_binding::operator==(const texture_binding& other) const {
+		return texture_id == other.texture_id && layer == other.layer;
+	}
+
+	texture_array::texture_array(const std::vector<image>& levels, const std::vector<compressed_image>& compressed)
+		: texture_id(0), width(levels[0].width), height(levels[0].height), components(levels[0].components),
+		format(compressed.empty() ? block_format::none : compressed[0].format), levels(levels.size()), capacity(0) {
+		// nop
+	}
+
+	bool texture_array::accepts(const std::vector<image>& levels, const std::vector<compressed_image>& compressed) const {
+		const block_format other_format = compressed.empty() ? block_format::none : compressed[0].format;
+		return levels[0].width == width && levels[0].height == height && levels[0].components == components
+			&& other_format == format && levels.size() == this->levels;
+	}
+
+	GLint texture_array::add(const std::vector<image>& levels, const std::vector<const unsigned char*>& data) {
+		size_t layer = 0;
+		while (layer < used.size() && used[layer])
+			++layer;
+		if (layer == capacity)
+			allocate(std::max<size_t>(4, capacity * 2));
+
+		used[layer] = true;
+		upload_layer(layer, levels, data);
+		return GLint(layer);
+	}
+
+	void texture_array::remove(GLint layer) {
+		used[layer] = false;
+	}
+
+
+	void texture_array::allocate(size_t capacity) {
+		GLuint id;
+		glGenTextures(1, &id);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, GLint(levels - 1));
+		const GLenum pixel_format = components == 3 ? GL_RGB : GL_RGBA;
+		for (size_t level = 0; level < levels; ++level) {
+			const GLsizei level_width = std::max(1, width >> level);
+			const GLsizei level_height = std::max(1, height >> level);
+			if (format != block_format::none) {
+				const size_t bytes = texture_level_bytes(level_width, level_height, components, format) * capacity;
+				glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, GLint(level), compressed_internal_format(format), level_width, level_height, GLsizei(capacity), 0, GLsizei(bytes), NULL);
+			}
+			else {
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, GLint(level), pixel_format, level_width, level_height, GLsizei(capacity), 0, pixel_format, GL_UNSIGNED_BYTE, NULL);
+			}
+		}
+
+		// the old layers move over on the GPU, read back through client memory only without copy_image
+		if (texture_id != 0) {
+			const size_t old_capacity = this->capacity;
+			for (size_t level = 0; level < levels; ++level) {
+				const GLsizei level_width = std::max(1, width >> level);
+				const GLsizei level_height = std::max(1, height >> level);
+				if (GLEW_ARB_copy_image) {
+					glCopyImageSubData(texture_id, GL_TEXTURE_2D_ARRAY, GLint(level), 0, 0, 0, id, GL_TEXTURE_2D_ARRAY, GLint(level), 0, 0, 0, level_width, level_height, GLsizei(old_capacity));
+					continue;
+				}
+
+				std::vector<unsigned char> pixels(texture_level_bytes(level_width, level_height, components, format) * old_capacity);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+				glPixelStorei(GL_PACK_ALIGNMENT, 1);
+				if (format != block_format::none)
+					glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, GLint(level), pixels.data());
+				else
+					glGetTexImage(GL_TEXTURE_2D_ARRAY, GLint(level), pixel_format, GL_UNSIGNED_BYTE, pixels.data());
+				glPixelStorei(GL_PACK_ALIGNMENT, 4);
+				glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+				if (format != block_format::none)
+					glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, GLint(level), 0, 0, 0, level_width, level_height, GLsizei(old_capacity),
+						compressed_internal_format(format), GLsizei(pixels.size()), pixels.data());
+				else
+					glTexSubImage3D(GL_TEXTURE_2D_ARRAY, GLint(level), 0, 0, 0, level_width, level_height, GLsizei(old_capacity), pixel_format, GL_UNSIGNED_BYTE, pixels.data());
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			}
+			glDeleteTextures(1, &texture_id);
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		texture_id = id;
+		this->capacity = capacity;
+		used.resize(capacity, false);
+	}
+
+	void texture_array::upload_layer(size_t layer, const std::vector<image>& levels, const std::vector<const unsigned char*>& data) const {
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (size_t level = 0; level < this->levels; ++level) {
+			const image& image = levels[level];
+			if (format != block_format::none) {
+				const size_t size = texture_level_bytes(image.width, image.height, components, format);
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, GLint(level), 0, 0, GLint(layer), image.width, image.height, 1,
+					compressed_internal_format(format), GLsizei(size), data[level]);
+			}
+			else {
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, GLint(level), 0, 0, GLint(layer), image.width, image.height, 1,
+					components == 3 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, data[level]);
+			}
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+
+	static decoded_texture build_texture(std::uint64_t hash, image decoded, block_format compression, int max_size) {
+		decoded_texture result;
+		result.hash = hash;
+		decoded.hash = hash;
+		result.source_width = decoded.width;
+		result.source_height = decoded.height;
+		// runs on a pool thread already, one texture per thread keeps the pool from oversubscribing
+		const size_t threads = 1;
+		result.levels = build_mip_chain(std::move(decoded), threads, max_size);
+		if (compression == block_format::none)
+			return result;
+
+		const auto start = std::chrono::steady_clock::now();
+		const block_format format = choose_block_format(result.levels[0], compression);
+		for (const image& level : result.levels)
+			result.compressed.push_back(compress(level, format, threads));
+		result.compress_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		result.psnr = psnr(result.levels[0], decompress(result.compressed[0]), format);
+		for (image& level : result.levels)
+			level.pixels = std::vector<unsigned char>();
+		return result;
+	}
+
+	static decoded_texture decode_texture(std::uint64_t hash, const unsigned char* bytes, size_t size, block_format compression, int max_size) {
+		image decoded;
+		if (!decoded.decode(bytes, size)) {
+			decoded_texture result;
+			result.hash = hash;
+			return result;
+		}
+		return build_texture(hash, std::move(decoded), compression, max_size);
+	}
+
+	decoded_texture::decoded_texture() : hash(0), content_hash(0), source_width(0), source_height(0), compress_ms(0.0), psnr(0.0), cached(false) {
+		// nop
+	}
+
+	texture_decoder::texture_decoder() : _decoded(0), _cached(0), _capped_bytes(0), _source_bytes(0) {
+		// nop
+	}
+
+	void texture_decoder::set_cache_directory(const std::string& directory) {
+		_cache_directory = directory;
+		if (!directory.empty())
+			trim_texture_cache(directory, texture_cache_budget);
+	}
+
+	// the disk cache is keyed by content, whatever key the registry uses
+	static decoded_texture decode_source(std::uint64_t hash, const unsigned char* bytes, size_t size, const std::string& cache_directory, block_format compression, int max_size) {
+		decoded_texture result;
+		result.hash = hash;
+		if (size == 0)
+			return result;
+
+		const std::uint64_t content_hash = hash_bytes(bytes, size, std::uint64_t(max_size));
+		const std::string cache_path = cache_directory.empty() ? std::string()
+			: texture_cache_path(cache_directory, content_hash, compression);
+		if (!cache_path.empty() && read_texture_cache(cache_path, result)) {
+			std::error_code error;
+			std::filesystem::last_write_time(cache_path, std::filesystem::file_time_type::clock::now(), error);
+			result.hash = hash;
+			result.content_hash = content_hash;
+			result.cached = true;
+			return result;
+		}
+
+		result = decode_texture(hash, bytes, size, compression, max_size);
+		result.content_hash = content_hash;
+		if (!cache_path.empty() && !result.levels.empty() && !write_texture_cache(cache_path, result))
+			std::cerr << "Cannot write texture cache [" << cache_path << "]\n";
+		return result;
+	}
+
+	void texture_decoder::push(std::future<decoded_texture>&& job) {
+		if (_pending.empty()) {
+			_start = std::chrono::steady_clock::now();
+			_decoded = 0;
+			_cached = 0;
+			_capped_bytes = 0;
+			_source_bytes = 0;
+		}
+		_pending.push_back(std::move(job));
+	}
+
+	void texture_decoder::decode(std::uint64_t hash, const void* data, size_t size, std::shared_ptr<const void> owner, block_format compression, int max_size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		push(_pool.submit([hash, bytes, size, owner, compression, max_size, cache_directory = _cache_directory]() {
+			return decode_source(hash, bytes, size, cache_directory, compression, max_size);
+		}));
+	}
+
+	void texture_decoder::decode(std::uint64_t hash, const std::string& filepath, block_format compression, int max_size) {
+		push(_pool.submit([hash, filepath, compression, max_size, cache_directory = _cache_directory]() {
+			std::vector<char> bytes;
+			if (!read_file(filepath, bytes))
+				std::cerr << "Cannot read texture [" << filepath << "]\n";
+			return decode_source(hash, reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size(), cache_directory, compression, max_size);
+		}));
+	}
+
+	void texture_decoder::decode(std::uint64_t hash, image&& decoded, block_format compression, int max_size) {
+		auto shared_image = std::make_shared<image>(std::move(decoded));
+		push(_pool.submit([hash, shared_image, compression, max_size]() {
+			return build_texture(hash, std::move(*shared_image), compression, max_size);
+		}));
+	}
+
+	std::vector<decoded_texture> texture_decoder::finished() {
+		std::vector<decoded_texture> result;
+		for (auto it = _pending.begin(); it != _pending.end();) {
+			if (it->wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				++it;
+				continue;
+			}
+			result.push_back(it->get());
+			it = _pending.erase(it);
+		}
+
+		for (const auto& texture : result) {
+			if (texture.cached)
+				_cached++;
+			if (!texture.levels.empty() && texture.source_width > texture.levels[0].width) {
+				const image& level = texture.levels[0];
+				const size_t source_bytes = mip_chain_bytes(texture.source_width, texture.source_height, level.components);
+				const size_t capped_bytes = mip_chain_bytes(level.width, level.height, level.components);
+				_source_bytes += source_bytes;
+				_capped_bytes += capped_bytes;
+				std::cout << "texture: capped " << texture.source_width << 'x' << texture.source_height << " -> " << level.width << 'x' << level.height
+					<< ", " << source_bytes << " -> " << capped_bytes << " bytes\n";
+			}
+			if (texture.compressed.empty() || texture.cached)
+				continue;
+			size_t raw_bytes = 0, compressed_bytes = 0;
+			for (size_t level = 0; level < texture.levels.size(); ++level) {
+				raw_bytes += size_t(texture.levels[level].width) * texture.levels[level].height * texture.levels[level].components;
+				compressed_bytes += texture.compressed[level].blocks.size();
+			}
+			std::cout << "texture: " << block_format_name(texture.compressed[0].format) << ' ' << texture.compressed[0].width << 'x' << texture.compressed[0].height
+				<< ", " << texture.compress_ms << " ms, " << texture.psnr << " dB PSNR, " << raw_bytes << " -> " << compressed_bytes << " bytes\n";
+		}
+
+		_decoded += result.size();
+		if (!result.empty() && _pending.empty()) {
+			const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _start);
+			std::cout << "textures: " << _decoded << " decoded (" << _cached << " cached) in " << elapsed.count() << " ms on " << _pool.size() << " threads\n";
+			if (_source_bytes > 0)
+				std::cout << "textures: capping reduced mip chains from " << double(_source_bytes) / (1 << 20) << " MB to " << double(_capped_bytes) / (1 << 20) << " MB before compression\n";
+		}
+		return result;
+	}
+
+	size_t texture_decoder::pending() const {
+		return _pending.size();
+	}
+}
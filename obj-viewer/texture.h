@@ -0,0 +1,105 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include <future> // future
+#include <memory> // shared_ptr
+#include <chrono> // steady_clock
+#include <cstdint> // uint64_t
+#include <GL/glew.h> // GLuint
+#include "object.h" // image
+#include "bcn.h" // block_format compressed_image
+#include "thread_pool.h" // thread_pool
+
+namespace obj_viewer {
+
+	GLenum compressed_internal_format(block_format format);
+	void upload_texture(GLuint texture_id, const image& image);
+	void upload_texture(GLuint texture_id, const std::vector<image>& levels);
+	void upload_texture(GLuint texture_id, const std::vector<compressed_image>& levels);
+	void upload_texture_level(GLuint texture_id, size_t level, const image& image);
+	void upload_texture_level(GLuint texture_id, size_t level, const compressed_image& image);
+	// the image gives the level's size and format, data its bytes, for levels that do not own them
+	void upload_texture_level(GLuint texture_id, size_t level, const image& image, const void* data);
+	void upload_texture_level(GLuint texture_id, size_t level, const compressed_image& image, const void* data);
+	size_t texture_level_bytes(int width, int height, int components, block_format format);
+	void release_texture_level(GLuint texture_id, size_t level);
+	void set_texture_levels(GLuint texture_id, size_t base_level, size_t levels);
+
+	class texture_binding {
+	public:
+		GLuint texture_id;
+		GLint layer;
+
+		texture_binding(GLuint texture_id, GLint layer);
+		bool operator<(const texture_binding& other) const;
+		bool operator==(const texture_binding& other) const;
+	};
+
+	class texture_array {
+	public:
+		GLuint texture_id;
+		int width;
+		int height;
+		int components;
+		block_format format;
+		size_t levels;
+		size_t capacity;
+		std::vector<bool> used;
+
+		texture_array(const std::vector<image>& levels, const std::vector<compressed_image>& compressed);
+		bool accepts(const std::vector<image>& levels, const std::vector<compressed_image>& compressed) const;
+		GLint add(const std::vector<image>& levels, const std::vector<const unsigned char*>& data);
+		void remove(GLint layer);
+
+	private:
+		void allocate(size_t capacity);
+		void upload_layer(size_t layer, const std::vector<image>& levels, const std::vector<const unsigned char*>& data) const;
+	};
+
+	class decoded_texture {
+	public:
+		std::uint64_t hash;
+		// hash of the encoded bytes, so a texture requested by path can find its content twin
+		std::uint64_t content_hash;
+		std::vector<image> levels;
+		std::vector<compressed_image> compressed;
+		// levels read from the disk cache point into its mapping instead of owning their bytes
+		std::shared_ptr<const void> mapping;
+		std::vector<const unsigned char*> level_data;
+		int source_width;
+		int source_height;
+		double compress_ms;
+		double psnr;
+		bool cached;
+
+		decoded_texture();
+	};
+
+	class texture_decoder {
+	public:
+		texture_decoder();
+
+		void set_cache_directory(const std::string& directory);
+		// reads the encoded bytes in place, keeping owner alive until the job is done
+		void decode(std::uint64_t hash, const void* data, size_t size, std::shared_ptr<const void> owner, block_format compression, int max_size);
+		// reads the file on the worker, so the caller never touches the bytes
+		void decode(std::uint64_t hash, const std::string& filepath, block_format compression, int max_size);
+		// builds the mip chain of an image that is decoded already
+		void decode(std::uint64_t hash, image&& decoded, block_format compression, int max_size);
+		std::vector<decoded_texture> finished();
+		size_t pending() const;
+
+	private:
+		void push(std::future<decoded_texture>&& job);
+
+		thread_pool _pool;
+		std::vector<std::future<decoded_texture>> _pending;
+		std::chrono::steady_clock::time_point _start;
+		size_t _decoded;
+		size_t _cached;
+		size_t _capped_bytes;
+		size_t _source_bytes;
+		std::string _cache_directory;
+	};
+}
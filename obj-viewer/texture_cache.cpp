@@ -0,0 +1,250 @@
+#include "texture_cache.h"
+
+#include <cstdio> // fopen fwrite snprintf
+#include <cstring> // memcpy memcmp
+#include <cctype> // isdigit isxdigit
+#include <atomic> // atomic
+#include <random> // random_device
+#include <algorithm> // min max sort
+#include <filesystem> // path rename directory_iterator
+#include <system_error> // error_code
+#include "mapped_file.h" // mapped_file
+
+namespace obj_viewer {
+
+	static const char texture_cache_magic[4] = { 'O', 'B', 'J', 'T' };
+	static const std::uint32_t texture_cache_version = 2;
+	static const std::uint32_t max_level_count = 16;
+
+	class texture_cache_header {
+	public:
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t level_count;
+		std::uint32_t format;
+		std::uint32_t components;
+		float psnr;
+		// the decoded image before max_size capped it
+		std::uint32_t source_width;
+		std::uint32_t source_height;
+	};
+
+	class texture_cache_level {
+	public:
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint64_t size;
+	};
+
+	static size_t align(size_t size) {
+		return (size + 7) & ~size_t(7);
+	}
+
+	std::string texture_cache_path(const std::string& directory, std::uint64_t hash, block_format compression) {
+		char name[64];
+		snprintf(name, sizeof(name), "%016llx.%s.texcache", static_cast<unsigned long long>(hash), block_format_name(compression));
+		return (std::filesystem::path(directory) / name).string();
+	}
+
+	bool write_texture_cache(const std::string& filepath, const decoded_texture& texture) {
+		const bool compressed = !texture.compressed.empty();
+		std::vector<unsigned char> bytes;
+		auto append = [&bytes](const void* data, size_t size) {
+			const unsigned char* begin = static_cast<const unsigned char*>(data);
+			bytes.insert(bytes.end(), begin, begin + size);
+		};
+
+		texture_cache_header header = {};
+		memcpy(header.magic, texture_cache_magic, sizeof(texture_cache_magic));
+		header.version = texture_cache_version;
+		header.level_count = std::uint32_t(texture.levels.size());
+		header.format = std::uint32_t(compressed ? texture.compressed[0].format : block_format::none);
+		header.components = std::uint32_t(texture.levels[0].components);
+		header.psnr = float(texture.psnr);
+		header.source_width = std::uint32_t(texture.source_width);
+		header.source_height = std::uint32_t(texture.source_height);
+		append(&header, sizeof(header));
+
+		for (size_t level = 0; level < texture.levels.size(); ++level) {
+			const std::vector<unsigned char>& data = compressed ? texture.compressed[level].blocks : texture.levels[level].pixels;
+			texture_cache_level level_header = {};
+			level_header.width = std::uint32_t(texture.levels[level].width);
+			level_header.height = std::uint32_t(texture.levels[level].height);
+			level_header.size = data.size();
+			append(&level_header, sizeof(level_header));
+			append(data.data(), data.size());
+			bytes.resize(align(bytes.size()), 0);
+		}
+
+		std::error_code error;
+		std::filesystem::create_directories(std::filesystem::path(filepath).parent_path(), error);
+		// unique per write, so two threads or viewers filling the same entry never share a file
+		static std::atomic<unsigned> writes(0);
+		const std::string temporary = filepath + '.' + std::to_string(std::random_device()()) + '.' + std::to_string(writes++) + ".tmp";
+		FILE* fp = fopen(temporary.c_str(), "wb");
+		if (fp == NULL)
+			return false;
+		const size_t written = fwrite(bytes.data(), 1, bytes.size(), fp);
+		fclose(fp);
+		if (written != bytes.size()) {
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+		std::filesystem::rename(temporary, filepath, error);
+		if (error) {
+			std::error_code remove_error;
+			std::filesystem::remove(temporary, remove_error);
+			return false;
+		}
+		return true;
+	}
+
+	static bool valid_format(std::uint32_t format, std::uint32_t components) {
+		if (components != 3 && components != 4)
+			return false;
+		return format == std::uint32_t(block_format::none) || format == std::uint32_t(block_format::bc1)
+			|| format == std::uint32_t(block_format::bc3) || format == std::uint32_t(block_format::bc5);
+	}
+
+	bool read_texture_cache(const std::string& filepath, decoded_texture& texture) {
+		auto file = std::make_shared<mapped_file>();
+		if (!file->open(filepath) || file->size() < sizeof(texture_cache_header))
+			return false;
+
+		const unsigned char* data = file->data();
+		const unsigned char* end = data + file->size();
+		const texture_cache_header* header = reinterpret_cast<const texture_cache_header*>(data);
+		if (memcmp(header->magic, texture_cache_magic, sizeof(texture_cache_magic)) != 0 || header->version != texture_cache_version)
+			return false;
+		if (header->level_count == 0 || header->level_count > max_level_count || !valid_format(header->format, header->components))
+			return false;
+
+		const block_format format = block_format(header->format);
+		const int components = int(header->components);
+		data += sizeof(texture_cache_header);
+
+		// every level is the previous one halved down to 1x1, with exactly the bytes its size needs
+		std::vector<image> levels;
+		std::vector<compressed_image> compressed;
+		std::vector<const unsigned char*> level_data;
+		for (std::uint32_t level = 0; level < header->level_count; ++level) {
+			if (end - data < std::ptrdiff_t(sizeof(texture_cache_level)))
+				return false;
+			const texture_cache_level* level_header = reinterpret_cast<const texture_cache_level*>(data);
+			data += sizeof(texture_cache_level);
+
+			const std::uint32_t width = level_header->width;
+			const std::uint32_t height = level_header->height;
+			if (level == 0 ? (width == 0 || height == 0 || std::max(width, height) >= 1u << max_level_count)
+				: (width != std::max(1u, std::uint32_t(levels.back().width) / 2) || height != std::max(1u, std::uint32_t(levels.back().height) / 2)))
+				return false;
+			const size_t size = texture_level_bytes(int(width), int(height), components, format);
+			if (level_header->size != size || size_t(end - data) < size)
+				return false;
+
+			image image;
+			image.width = int(width);
+			image.height = int(height);
+			image.components = components;
+			image.hash = texture.hash;
+			if (format != block_format::none) {
+				compressed_image blocks;
+				blocks.width = image.width;
+				blocks.height = image.height;
+				blocks.format = format;
+				blocks.hash = texture.hash;
+				compressed.push_back(std::move(blocks));
+			}
+			levels.push_back(std::move(image));
+			level_data.push_back(data);
+			data += std::min(align(size), size_t(end - data));
+		}
+		if (levels.back().width != 1 || levels.back().height != 1)
+			return false;
+		if (header->source_width < std::uint32_t(levels[0].width) || header->source_height < std::uint32_t(levels[0].height) || std::max(header->source_width, header->source_height) >= 1u << 30)
+			return false;
+
+		texture.levels = std::move(levels);
+		texture.compressed = std::move(compressed);
+		texture.level_data = std::move(level_data);
+		texture.mapping = std::move(file);
+		texture.psnr = header->psnr;
+		texture.source_width = int(header->source_width);
+		texture.source_height = int(header->source_height);
+		return true;
+	}
+
+	static bool digits(const std::string& text, size_t begin, size_t end, bool hexadecimal) {
+		if (begin >= end)
+			return false;
+		for (size_t i = begin; i < end; ++i) {
+			const unsigned char c = static_cast<unsigned char>(text[i]);
+			if (!(hexadecimal ? isxdigit(c) : isdigit(c)))
+				return false;
+		}
+		return true;
+	}
+
+	// "<16 hex digits>.<format>.texcache" as texture_cache_path names entries, or a temporary
+	// "<entry>.<number>.<number>.tmp" a write left behind
+	static bool is_texture_cache_file(const std::string& name) {
+		static const std::string extension = ".texcache";
+		if (name.size() < 17 || !digits(name, 0, 16, true) || name[16] != '.')
+			return false;
+		const size_t found = name.find(extension, 17);
+		if (found == std::string::npos)
+			return false;
+		bool known = false;
+		for (const block_format format : { block_format::none, block_format::automatic, block_format::bc1, block_format::bc3, block_format::bc5 })
+			known = known || name.compare(17, found - 17, block_format_name(format)) == 0;
+		if (!known)
+			return false;
+
+		const size_t rest = found + extension.size();
+		if (rest == name.size())
+			return true;
+		// .<number>.<number>.tmp
+		static const std::string temporary = ".tmp";
+		if (name.size() < rest + temporary.size() || name.compare(name.size() - temporary.size(), temporary.size(), temporary) != 0 || name[rest] != '.')
+			return false;
+		const size_t last = name.size() - temporary.size();
+		const size_t dot = name.find('.', rest + 1);
+		return dot < last && digits(name, rest + 1, dot, false) && digits(name, dot + 1, last, false);
+	}
+
+	// drops the least recently used entries, touched on every hit, until the directory fits.
+	// only files named like cache entries count, the directory may be shared with anything else
+	void trim_texture_cache(const std::string& directory, size_t max_bytes) {
+		class cache_file {
+		public:
+			std::filesystem::path path;
+			std::filesystem::file_time_type time;
+			std::uintmax_t size;
+		};
+
+		std::error_code error;
+		std::vector<cache_file> files;
+		std::uintmax_t total = 0;
+		for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+			std::error_code entry_error;
+			if (!is_texture_cache_file(it->path().filename().string()) || !it->is_regular_file(entry_error))
+				continue;
+			cache_file file = { it->path(), it->last_write_time(entry_error), it->file_size(entry_error) };
+			if (entry_error)
+				continue;
+			files.push_back(file);
+			total += file.size;
+		}
+		if (total <= max_bytes)
+			return;
+
+		std::sort(files.begin(), files.end(), [](const cache_file& a, const cache_file& b) { return a.time < b.time; });
+		for (const cache_file& file : files) {
+			if (total <= max_bytes)
+				break;
+			std::error_code remove_error;
+			if (std::filesystem::remove(file.path, remove_error))
+				total -= file.size;
+		}
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string> // string
+#include <cstdint> // uint64_t
+#include "bcn.h" // block_format
+#include "texture.h" // decoded_texture
+
+namespace obj_viewer {
+
+	std::string texture_cache_path(const std::string& directory, std::uint64_t hash, block_format compression);
+	bool write_texture_cache(const std::string& filepath, const decoded_texture& texture);
+	// the levels of a hit point into the mapped file, which the texture keeps alive
+	bool read_texture_cache(const std::string& filepath, decoded_texture& texture);
+	void trim_texture_cache(const std::string& directory, size_t max_bytes);
+}
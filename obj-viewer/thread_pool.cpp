@@ -0,0 +1,41 @@
+#include "thread_pool.h"
+
+#include <algorithm> // max
+
+namespace obj_viewer {
+
+	thread_pool::thread_pool(size_t threads) : _stopping(false) {
+		threads = std::max<size_t>(threads, 1);
+		for (size_t i = 0; i < threads; ++i)
+			_workers.emplace_back(&thread_pool::work, this);
+	}
+
+	thread_pool::~thread_pool() {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_stopping = true;
+		}
+		_available.notify_all();
+		for (auto& worker : _workers)
+			worker.join();
+	}
+
+	size_t thread_pool::size() const {
+		return _workers.size();
+	}
+
+	void thread_pool::work() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_available.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+				if (_tasks.empty())
+					return;
+				task = std::move(_tasks.front());
+				_tasks.pop();
+			}
+			task();
+		}
+	}
+}
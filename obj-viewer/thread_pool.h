@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector> // vector
+#include <queue> // queue
+#include <thread> // thread
+#include <mutex> // mutex unique_lock
+#include <condition_variable> // condition_variable
+#include <functional> // function
+#include <future> // future packaged_task
+#include <memory> // make_shared
+
+namespace obj_viewer {
+
+	class thread_pool {
+	public:
+		thread_pool(size_t threads = std::thread::hardware_concurrency());
+		~thread_pool();
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		template <typename F>
+		auto submit(F task) -> std::future<decltype(task())> {
+			auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+			auto result = packaged->get_future();
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_tasks.push([packaged]() { (*packaged)(); });
+			}
+			_available.notify_one();
+			return result;
+		}
+
+		size_t size() const;
+
+	private:
+		std::vector<std::thread> _workers;
+		std::queue<std::function<void()>> _tasks;
+		std::mutex _mutex;
+		std::condition_variable _available;
+		bool _stopping;
+
+		void work();
+	};
+}
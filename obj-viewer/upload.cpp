@@ -0,0 +1,277 @@
+#include "upload.h"
+
+#include <cstring> // memcpy
+#include <algorithm> // min max remove_if
+#include "texture.h" // upload_texture_level compressed_internal_format
+
+namespace obj_viewer {
+
+	static const size_t segment_count = 3;
+
+	class staging_chunk {
+	public:
+		size_t index;
+		size_t offset;
+		size_t staging_offset;
+		size_t size;
+	};
+
+	upload_queue::upload::upload() : target(0), id(0), level(0), width(0), height(0), format(0), compressed(false), row_bytes(1), row_height(1), data(NULL), size(0), offset(0), ticket(0) {
+		// nop
+	}
+
+	upload_queue::segment::segment() : fence(0), ticket(0) {
+		// nop
+	}
+
+	upload_queue::upload_queue() : _staging(0), _mapped(NULL), _segment_size(0), _current(0), _next_ticket(1), _submitted(0), _retired(0) {
+		// nop
+	}
+
+	upload_queue& upload_queue::instance() {
+		static upload_queue* instance = new upload_queue();
+		return *instance;
+	}
+
+	void upload_queue::init(size_t budget) {
+		if (budget == 0 || !GLEW_ARB_sync || !GLEW_ARB_copy_buffer)
+			return;
+
+		const size_t size = budget * segment_count;
+		_segment_size = budget;
+		_segments.resize(segment_count);
+		glGenBuffers(1, &_staging);
+		glBindBuffer(GL_COPY_READ_BUFFER, _staging);
+		if (GLEW_ARB_buffer_storage) {
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			// dynamic storage keeps the glBufferSubData fallback legal if mapping fails
+			glBufferStorage(GL_COPY_READ_BUFFER, size, NULL, flags | GL_DYNAMIC_STORAGE_BIT);
+			_mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, flags));
+		}
+		else {
+			glBufferData(GL_COPY_READ_BUFFER, size, NULL, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+
+	size_t upload_queue::upload_buffer(GLuint buffer_id, const void* data, size_t size, std::shared_ptr<const void> owner) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_id);
+		if (_staging == 0) {
+			glBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_STATIC_DRAW);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			return 0;
+		}
+		glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		cancel(buffer_id);
+		if (size == 0)
+			return 0;
+
+		upload upload;
+		upload.target = GL_COPY_WRITE_BUFFER;
+		upload.id = buffer_id;
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		if (owner) {
+			upload.owner = std::move(owner);
+			upload.data = bytes;
+			upload.size = size;
+		}
+		else
+			upload.bytes.assign(bytes, bytes + size);
+		return push(std::move(upload));
+	}
+
+	size_t upload_queue::upload_texture_level(GLuint texture_id, size_t level, image&& image) {
+		upload upload;
+		if (!stage_texture_level(texture_id, level, image.width, image.height, image.components, block_format::none, upload)) {
+			obj_viewer::upload_texture_level(texture_id, level, image);
+			return 0;
+		}
+		upload.bytes = std::move(image.pixels);
+		return push(std::move(upload));
+	}
+
+	size_t upload_queue::upload_texture_level(GLuint texture_id, size_t level, compressed_image&& image) {
+		upload upload;
+		if (!stage_texture_level(texture_id, level, image.width, image.height, 0, image.format, upload)) {
+			obj_viewer::upload_texture_level(texture_id, level, image);
+			return 0;
+		}
+		upload.bytes = std::move(image.blocks);
+		return push(std::move(upload));
+	}
+
+	size_t upload_queue::upload_texture_level(GLuint texture_id, size_t level, const image& image, const void* data, std::shared_ptr<const void> owner) {
+		upload upload;
+		if (!stage_texture_level(texture_id, level, image.width, image.height, image.components, block_format::none, upload)) {
+			obj_viewer::upload_texture_level(texture_id, level, image, data);
+			return 0;
+		}
+		upload.owner = std::move(owner);
+		upload.data = static_cast<const unsigned char*>(data);
+		upload.size = texture_level_bytes(image.width, image.height, image.components, block_format::none);
+		return push(std::move(upload));
+	}
+
+	size_t upload_queue::upload_texture_level(GLuint texture_id, size_t level, const compressed_image& image, const void* data, std::shared_ptr<const void> owner) {
+		upload upload;
+		if (!stage_texture_level(texture_id, level, image.width, image.height, 0, image.format, upload)) {
+			obj_viewer::upload_texture_level(texture_id, level, image, data);
+			return 0;
+		}
+		upload.owner = std::move(owner);
+		upload.data = static_cast<const unsigned char*>(data);
+		upload.size = texture_level_bytes(image.width, image.height, 0, image.format);
+		return push(std::move(upload));
+	}
+
+	// allocates the level and describes its upload, false when it has to go straight to GL
+	bool upload_queue::stage_texture_level(GLuint texture_id, size_t level, int width, int height, int components, block_format format, upload& upload) const {
+		const bool compressed = format != block_format::none;
+		const size_t row_bytes = compressed ? texture_level_bytes(width, 1, components, format) : size_t(width) * components;
+		if (_staging == 0 || row_bytes > _segment_size)
+			return false;
+
+		upload.target = GL_TEXTURE_2D;
+		upload.id = texture_id;
+		upload.level = GLint(level);
+		upload.width = width;
+		upload.height = height;
+		upload.format = compressed ? compressed_internal_format(format) : components == 3 ? GL_RGB : GL_RGBA;
+		upload.compressed = compressed;
+		upload.row_bytes = row_bytes;
+		upload.row_height = compressed ? 4 : 1;
+
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		if (compressed)
+			glCompressedTexImage2D(GL_TEXTURE_2D, upload.level, upload.format, width, height, 0, GLsizei(texture_level_bytes(width, height, components, format)), NULL);
+		else
+			glTexImage2D(GL_TEXTURE_2D, upload.level, upload.format, width, height, 0, upload.format, GL_UNSIGNED_BYTE, NULL);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return true;
+	}
+
+	void upload_queue::cancel(GLuint buffer_id) {
+		_pending.erase(std::remove_if(_pending.begin(), _pending.end(), [buffer_id](const upload& upload) {
+			return upload.target == GL_COPY_WRITE_BUFFER && upload.id == buffer_id;
+		}), _pending.end());
+	}
+
+	void upload_queue::cancel_texture(GLuint texture_id) {
+		_pending.erase(std::remove_if(_pending.begin(), _pending.end(), [texture_id](const upload& upload) {
+			return upload.target == GL_TEXTURE_2D && upload.id == texture_id;
+		}), _pending.end());
+	}
+
+	bool upload_queue::ready(size_t ticket) const {
+		return ticket <= _retired;
+	}
+
+	void upload_queue::update() {
+		retire();
+		if (_staging == 0 || _pending.empty() || _segments[_current].fence != 0)
+			return;
+
+		const size_t base = _current * _segment_size;
+		unsigned char* target = _mapped != NULL ? _mapped + base : NULL;
+		// a segment the driver refuses to map is filled in client memory and sent with glBufferSubData
+		std::vector<unsigned char> fallback;
+		if (target == NULL) {
+			glBindBuffer(GL_COPY_READ_BUFFER, _staging);
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+			target = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_READ_BUFFER, base, _segment_size, flags));
+			if (target == NULL) {
+				fallback.resize(_segment_size);
+				target = fallback.data();
+			}
+		}
+
+		std::vector<staging_chunk> chunks;
+		size_t used = 0;
+		for (size_t i = 0; i < _pending.size() && used < _segment_size; ++i) {
+			upload& upload = _pending[i];
+			const size_t remaining = upload.size - upload.offset;
+			size_t size = std::min(remaining, _segment_size - used);
+			if (size < remaining)
+				size -= size % upload.row_bytes;
+			if (size == 0)
+				break;
+
+			memcpy(target + used, upload.data + upload.offset, size);
+			chunks.push_back({ i, upload.offset, base + used, size });
+			upload.offset += size;
+			used = std::min(_segment_size, (used + size + 15) & ~size_t(15));
+		}
+
+		glBindBuffer(GL_COPY_READ_BUFFER, _staging);
+		if (!fallback.empty())
+			glBufferSubData(GL_COPY_READ_BUFFER, base, used, fallback.data());
+		else if (_mapped == NULL)
+			glUnmapBuffer(GL_COPY_READ_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _staging);
+		for (const staging_chunk& chunk : chunks)
+			submit(_pending[chunk.index], chunk.offset, chunk.staging_offset, chunk.size);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+		while (!_pending.empty() && _pending.front().offset == _pending.front().size) {
+			_submitted = _pending.front().ticket;
+			_pending.pop_front();
+		}
+
+		segment& segment = _segments[_current];
+		segment.ticket = _submitted;
+		segment.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		_current = (_current + 1) % _segments.size();
+	}
+
+	size_t upload_queue::push(upload&& upload) {
+		upload.ticket = _next_ticket++;
+		_pending.push_back(std::move(upload));
+		auto& pushed = _pending.back();
+		if (!pushed.owner) {
+			pushed.data = pushed.bytes.data();
+			pushed.size = pushed.bytes.size();
+		}
+		return pushed.ticket;
+	}
+
+	void upload_queue::retire() {
+		for (segment& segment : _segments) {
+			if (segment.fence == 0)
+				continue;
+			const GLenum status = glClientWaitSync(segment.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				continue;
+			glDeleteSync(segment.fence);
+			segment.fence = 0;
+			_retired = std::max(_retired, segment.ticket);
+		}
+	}
+
+	void upload_queue::submit(const upload& upload, size_t offset, size_t staging_offset, size_t size) const {
+		if (upload.target == GL_COPY_WRITE_BUFFER) {
+			glBindBuffer(GL_COPY_WRITE_BUFFER, upload.id);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, staging_offset, offset, size);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			return;
+		}
+
+		const int y = int(offset / upload.row_bytes * upload.row_height);
+		const int rows = int((size + upload.row_bytes - 1) / upload.row_bytes * upload.row_height);
+		const int height = std::min(rows, upload.height - y);
+		const GLvoid* pixels = reinterpret_cast<const GLvoid*>(staging_offset);
+		glBindTexture(GL_TEXTURE_2D, upload.id);
+		if (upload.compressed) {
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, y, upload.width, height, upload.format, GLsizei(size), pixels);
+		}
+		else {
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, y, upload.width, height, upload.format, GL_UNSIGNED_BYTE, pixels);
+			// back to the GL default so later unpacking elsewhere is not affected
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector> // vector
+#include <deque> // deque
+#include <memory> // shared_ptr
+#include <GL/glew.h> // GLuint GLsync
+#include "object.h" // image
+#include "bcn.h" // compressed_image
+
+namespace obj_viewer {
+
+	class upload_queue {
+	public:
+		static upload_queue& instance();
+		upload_queue(const upload_queue&) = delete;
+		upload_queue& operator=(const upload_queue&) = delete;
+
+		void init(size_t budget);
+		// without an owner the bytes are copied, with one they are read in place while it is kept alive
+		size_t upload_buffer(GLuint buffer_id, const void* data, size_t size, std::shared_ptr<const void> owner = nullptr);
+		size_t upload_texture_level(GLuint texture_id, size_t level, image&& image);
+		size_t upload_texture_level(GLuint texture_id, size_t level, compressed_image&& image);
+		// the image only describes the level, its bytes are read from data in place while owner is kept alive
+		size_t upload_texture_level(GLuint texture_id, size_t level, const image& image, const void* data, std::shared_ptr<const void> owner);
+		size_t upload_texture_level(GLuint texture_id, size_t level, const compressed_image& image, const void* data, std::shared_ptr<const void> owner);
+		void cancel(GLuint buffer_id);
+		void cancel_texture(GLuint texture_id);
+		bool ready(size_t ticket) const;
+		void update();
+
+	private:
+		class upload {
+		public:
+			GLenum target;
+			GLuint id;
+			GLint level;
+			int width;
+			int height;
+			GLenum format;
+			bool compressed;
+			size_t row_bytes;
+			size_t row_height;
+			std::vector<unsigned char> bytes;
+			std::shared_ptr<const void> owner;
+			const unsigned char* data;
+			size_t size;
+			size_t offset;
+			size_t ticket;
+
+			upload();
+		};
+
+		class segment {
+		public:
+			GLsync fence;
+			size_t ticket;
+
+			segment();
+		};
+
+		std::deque<upload> _pending;
+		std::vector<segment> _segments;
+		GLuint _staging;
+		unsigned char* _mapped;
+		size_t _segment_size;
+		size_t _current;
+		size_t _next_ticket;
+		size_t _submitted;
+		size_t _retired;
+
+		upload_queue();
+		size_t push(upload&& upload);
+		bool stage_texture_level(GLuint texture_id, size_t level, int width, int height, int components, block_format format, upload& upload) const;
+		void retire();
+		void submit(const upload& upload, size_t offset, size_t staging_offset, size_t size) const;
+	};
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include <cmath> // lround
+#include <cstdint> // int8_t uint8_t int16_t uint16_t uint32_t
+#include <cstring> // memcpy
+#include <limits> // numeric_limits
+#include <utility> // index_sequence
+#include <type_traits> // is_same is_signed
+#include <GL/glew.h> // GLuint GLenum glVertexAttribPointer
+#include <glm/glm.hpp> // vec4 clamp
+#include <glm/packing.hpp> // unpackUnorm4x8
+#include <glm/gtc/packing.hpp> // packHalf1x16
+#include "mesh_data.h" // vertices vertex_stream
+
+namespace obj_viewer {
+
+	class half {
+	public:
+		std::uint16_t bits;
+	};
+
+	template <typename T> class gl_component;
+	template <> class gl_component<float> { public: static const GLenum type = GL_FLOAT; };
+	template <> class gl_component<half> { public: static const GLenum type = GL_HALF_FLOAT; };
+	template <> class gl_component<std::int8_t> { public: static const GLenum type = GL_BYTE; };
+	template <> class gl_component<std::uint8_t> { public: static const GLenum type = GL_UNSIGNED_BYTE; };
+	template <> class gl_component<std::int16_t> { public: static const GLenum type = GL_SHORT; };
+	template <> class gl_component<std::uint16_t> { public: static const GLenum type = GL_UNSIGNED_SHORT; };
+
+	template <typename T, bool Normalized>
+	inline T convert_component(float value) {
+		if constexpr (std::is_same<T, float>::value)
+			return value;
+		else if constexpr (std::is_same<T, half>::value)
+			return half{ glm::packHalf1x16(value) };
+		else if constexpr (Normalized && std::is_signed<T>::value)
+			return T(std::lround(glm::clamp(value, -1.0f, 1.0f) * std::numeric_limits<T>::max()));
+		else if constexpr (Normalized)
+			return T(std::lround(glm::clamp(value, 0.0f, 1.0f) * std::numeric_limits<T>::max()));
+		else
+			return T(value);
+	}
+
+	enum class attribute_source { position, normal, texture_coordinate, color };
+
+	template <attribute_source Source> class source_traits;
+
+	template <> class source_traits<attribute_source::position> {
+	public:
+		static constexpr unsigned stream = 0;
+		static constexpr int components = 3;
+		static constexpr const char* name = "POSITION";
+		static glm::vec4 constant() { return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); }
+		static const void* data(const vertices& vertices) { return vertices.positions.data(); }
+		static glm::vec4 read(const vertices& vertices, size_t i) { return glm::vec4(vertices.positions[i], 1.0f); }
+	};
+
+	template <> class source_traits<attribute_source::normal> {
+	public:
+		static constexpr unsigned stream = stream_normals;
+		static constexpr int components = 3;
+		static constexpr const char* name = "NORMAL";
+		static glm::vec4 constant() { return glm::vec4(0.0f); }
+		static const void* data(const vertices& vertices) { return vertices.normals.data(); }
+		static glm::vec4 read(const vertices& vertices, size_t i) { return glm::vec4(vertices.normals[i], 0.0f); }
+	};
+
+	template <> class source_traits<attribute_source::texture_coordinate> {
+	public:
+		static constexpr unsigned stream = stream_texture_coordinates;
+		static constexpr int components = 2;
+		static constexpr const char* name = "TEXTURE_COORDINATE";
+		static glm::vec4 constant() { return glm::vec4(0.0f); }
+		static const void* data(const vertices& vertices) { return vertices.texture_coordinates.data(); }
+		static glm::vec4 read(const vertices& vertices, size_t i) { return glm::vec4(vertices.texture_coordinates[i], 0.0f, 0.0f); }
+	};
+
+	template <> class source_traits<attribute_source::color> {
+	public:
+		static constexpr unsigned stream = stream_colors;
+		static constexpr int components = 4;
+		static constexpr const char* name = "COLOR";
+		static glm::vec4 constant() { return glm::vec4(1.0f); }
+		static const void* data(const vertices& vertices) { return vertices.colors.data(); }
+		static glm::vec4 read(const vertices& vertices, size_t i) { return glm::unpackUnorm4x8(vertices.colors[i]); }
+	};
+
+	// one attribute of a vertex format: where it comes from, where it goes and how it is stored
+	template <attribute_source Source, GLuint Location, typename T, int Components, bool Normalized = false>
+	class vertex_attribute {
+	public:
+		typedef source_traits<Source> source;
+
+		static constexpr GLuint location = Location;
+		static constexpr unsigned stream = source::stream;
+		static constexpr size_t size = sizeof(T) * Components;
+		// the packed layout matches the vertices array, so it can be uploaded without packing
+		static constexpr bool identity = (Source == attribute_source::color)
+			? (std::is_same<T, std::uint8_t>::value && Components == 4 && Normalized)
+			: (std::is_same<T, float>::value && Components == source::components);
+
+		static void pack(const vertices& vertices, size_t i, unsigned char* out) {
+			const glm::vec4 value = source::read(vertices, i);
+			T packed[Components];
+			for (int c = 0; c < Components; ++c)
+				packed[c] = convert_component<T, Normalized>(value[c]);
+			memcpy(out, packed, size);
+		}
+
+		static void pointer(GLsizei stride, size_t offset) {
+			glVertexAttribPointer(Location, Components, gl_component<T>::type, Normalized ? GL_TRUE : GL_FALSE, stride, reinterpret_cast<const GLvoid*>(offset));
+		}
+
+		static void constant() {
+			const glm::vec4 value = source::constant();
+			glVertexAttrib4f(Location, value.x, value.y, value.z, value.w);
+		}
+
+		static std::string define() {
+			return std::string("#define ") + source::name + "_LOCATION " + std::to_string(Location) + "\n";
+		}
+	};
+
+	// a list of attributes either interleaved into one buffer or kept one buffer per attribute.
+	// attributes whose stream a mesh lacks are dropped, with one specialized packer per stream set
+	template <bool Interleaved, typename... Attributes>
+	class vertex_format {
+	public:
+		static constexpr bool interleaved = Interleaved;
+		static constexpr unsigned streams = (Attributes::stream | ...);
+
+		template <unsigned Present>
+		static constexpr size_t stride() {
+			return (((Attributes::stream & ~Present) == 0 ? Attributes::size : 0) + ...);
+		}
+
+		static size_t stride(unsigned present) {
+			return stride(present & streams, std::make_index_sequence<streams + 1>());
+		}
+
+		static std::vector<unsigned char> pack(const vertices& vertices, unsigned present) {
+			return pack(vertices, present & streams, std::make_index_sequence<streams + 1>());
+		}
+
+		template <typename Attribute>
+		static std::vector<unsigned char> pack_attribute(const vertices& vertices) {
+			const size_t size = vertices.positions.size();
+			std::vector<unsigned char> result(size * Attribute::size);
+			if constexpr (Attribute::identity)
+				memcpy(result.data(), Attribute::source::data(vertices), result.size());
+			else {
+				for (size_t i = 0; i < size; ++i)
+					Attribute::pack(vertices, i, &result[i * Attribute::size]);
+			}
+			return result;
+		}
+
+		static void enable(unsigned present) {
+			(enable_attribute<Attributes>(present), ...);
+		}
+
+		static void pointers(unsigned present) {
+			pointers(present & streams, std::make_index_sequence<streams + 1>());
+		}
+
+		template <typename Function>
+		static void for_each_attribute(Function function) {
+			(function(Attributes()), ...);
+		}
+
+		// values read by the shader for attributes a mesh does not provide
+		static void constants() {
+			(Attributes::constant(), ...);
+		}
+
+		static std::string defines() {
+			return (Attributes::define() + ...);
+		}
+
+	private:
+		template <unsigned Present, typename Attribute>
+		static void pack_attribute(const vertices& vertices, size_t i, unsigned char* out, size_t& offset) {
+			if constexpr ((Attribute::stream & ~Present) == 0) {
+				Attribute::pack(vertices, i, out + offset);
+				offset += Attribute::size;
+			}
+		}
+
+		template <unsigned Present>
+		static std::vector<unsigned char> pack_streams(const vertices& vertices) {
+			constexpr size_t stride = vertex_format::stride<Present>();
+			const size_t size = vertices.positions.size();
+			std::vector<unsigned char> result(size * stride);
+			unsigned char* out = result.data();
+			for (size_t i = 0; i < size; ++i, out += stride) {
+				size_t offset = 0;
+				(pack_attribute<Present, Attributes>(vertices, i, out, offset), ...);
+			}
+			return result;
+		}
+
+		template <size_t... Masks>
+		static size_t stride(unsigned present, std::index_sequence<Masks...>) {
+			static const size_t strides[] = { stride<unsigned(Masks)>()... };
+			return strides[present];
+		}
+
+		template <size_t... Masks>
+		static std::vector<unsigned char> pack(const vertices& vertices, unsigned present, std::index_sequence<Masks...>) {
+			typedef std::vector<unsigned char> (*packer)(const obj_viewer::vertices&);
+			static const packer packers[] = { &pack_streams<unsigned(Masks)>... };
+			return packers[present](vertices);
+		}
+
+		template <unsigned Present, typename Attribute>
+		static void pointer(size_t& offset) {
+			if constexpr ((Attribute::stream & ~Present) == 0) {
+				Attribute::pointer(GLsizei(stride<Present>()), offset);
+				offset += Attribute::size;
+			}
+		}
+
+		template <unsigned Present>
+		static void pointers_streams() {
+			size_t offset = 0;
+			(pointer<Present, Attributes>(offset), ...);
+		}
+
+		template <size_t... Masks>
+		static void pointers(unsigned present, std::index_sequence<Masks...>) {
+			typedef void (*setup)();
+			static const setup setups[] = { &pointers_streams<unsigned(Masks)>... };
+			setups[present]();
+		}
+
+		template <typename Attribute>
+		static void enable_attribute(unsigned present) {
+			if ((Attribute::stream & ~present) == 0)
+				glEnableVertexAttribArray(Attribute::location);
+			else
+				glDisableVertexAttribArray(Attribute::location);
+		}
+	};
+
+	// per-instance model transform, one mat4 spread over four consecutive locations
+	class instance_transform {
+	public:
+		static constexpr GLuint location = 4;
+		static constexpr int columns = 4;
+
+		// expects the instance buffer bound to GL_ARRAY_BUFFER and the mesh vertex array bound
+		static void enable() {
+			for (int c = 0; c < columns; ++c) {
+				glEnableVertexAttribArray(location + c);
+				glVertexAttribPointer(location + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), reinterpret_cast<const GLvoid*>(sizeof(glm::vec4) * c));
+				glVertexAttribDivisor(location + c, 1);
+			}
+		}
+
+		static void disable() {
+			for (int c = 0; c < columns; ++c)
+				glDisableVertexAttribArray(location + c);
+		}
+
+		// identity for draws without an instance buffer
+		static void constant() {
+			for (int c = 0; c < columns; ++c)
+				glVertexAttrib4f(location + c, c == 0 ? 1.0f : 0.0f, c == 1 ? 1.0f : 0.0f, c == 2 ? 1.0f : 0.0f, c == 3 ? 1.0f : 0.0f);
+		}
+
+		static std::string define() {
+			return "#define INSTANCE_LOCATION " + std::to_string(location) + "\n";
+		}
+	};
+
+	typedef vertex_format<false,
+		vertex_attribute<attribute_source::position, 0, float, 3>,
+		vertex_attribute<attribute_source::texture_coordinate, 1, float, 2>,
+		vertex_attribute<attribute_source::normal, 2, float, 3>,
+		vertex_attribute<attribute_source::color, 3, std::uint8_t, 4, true>> separate_format;
+
+	typedef vertex_format<true,
+		vertex_attribute<attribute_source::position, 0, float, 3>,
+		vertex_attribute<attribute_source::normal, 2, float, 3>,
+		vertex_attribute<attribute_source::texture_coordinate, 1, float, 2>,
+		vertex_attribute<attribute_source::color, 3, std::uint8_t, 4, true>> interleaved_format;
+
+	typedef vertex_format<true,
+		vertex_attribute<attribute_source::position, 0, float, 3>,
+		vertex_attribute<attribute_source::normal, 2, std::int8_t, 4, true>,
+		vertex_attribute<attribute_source::texture_coordinate, 1, half, 2>,
+		vertex_attribute<attribute_source::color, 3, std::uint8_t, 4, true>> compact_format;
+
+	// the cache file vertex record, uploaded without repacking; every attribute keeps its slot even when unused
+	typedef vertex_format<true,
+		vertex_attribute<attribute_source::position, 0, std::uint16_t, 4, true>,
+		vertex_attribute<attribute_source::normal, 2, std::int8_t, 4, true>,
+		vertex_attribute<attribute_source::texture_coordinate, 1, half, 2>> quantized_format;
+
+	std::string vertex_layout_defines();
+	void set_vertex_layout_constants();
+	// stride and attribute setup of one interleaved vertex buffer in the current layout, or quantized_format for stream_quantized
+	size_t vertex_layout_stride(unsigned streams);
+	void set_vertex_layout_pointers(unsigned streams);
+}
@@ -1,33 +1,92 @@
 #version 330 core
 
-layout(location = 0) in vec3 vertexPosition;
-layout(location = 1) in vec2 vertexUV;
-layout(location = 2) in vec3 vertexNormal;
+#ifdef INDIRECT
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+
+layout(location = POSITION_LOCATION) in vec3 vertexPosition;
+layout(location = TEXTURE_COORDINATE_LOCATION) in vec2 vertexUV;
+layout(location = NORMAL_LOCATION) in vec3 vertexNormal;
+layout(location = COLOR_LOCATION) in vec4 vertexColor;
 
 out vec2 UV;
+out vec4 color;
 out vec3 vertexPosition_world;
 out vec3 vertexNormal_camera;
 out vec3 cameraDirection_camera;
 out vec3 lightDirection_camera;
 
+#ifdef INDIRECT
+struct draw_data {
+	vec4 diffuse;
+	vec4 specular;
+	vec4 ambient;
+	vec4 positionOffset;
+	vec4 positionScale;
+	vec2 textureOffset;
+	vec2 textureScale;
+	int object;
+	int layer;
+	float shininess;
+	float padding;
+};
+
+layout(std430, binding = 0) readonly buffer Objects { mat4 models[]; };
+layout(std430, binding = 1) readonly buffer Draws { draw_data draws[]; };
+layout(std430, binding = 2) readonly buffer Instances { mat4 instances[]; };
+uniform int drawOffset;
+
+flat out vec3 diffuse;
+flat out vec3 specular;
+flat out vec3 ambient;
+flat out float shininess;
+flat out int textureLayer;
+#else
+layout(location = INSTANCE_LOCATION) in mat4 instanceTransform;
+
 uniform mat4 ModelView;
 uniform mat4 Model;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform vec2 textureOffset;
+uniform vec2 textureScale;
+#endif
 uniform mat4 View;
 uniform mat4 Projection;
 uniform vec3 lightPosition;
 
 void main() { 
 	vec3 cameraPosition_world = vec3(0.0, 0.0, 4.0);
+#ifdef INDIRECT
+	draw_data draw = draws[drawOffset + gl_DrawIDARB];
+	mat4 instanceTransform = instances[gl_BaseInstanceARB + gl_InstanceID];
+	mat4 Model = models[draw.object];
+	mat4 ModelView = View * Model;
+	diffuse = draw.diffuse.rgb;
+	specular = draw.specular.rgb;
+	ambient = draw.ambient.rgb;
+	shininess = draw.shininess;
+	textureLayer = draw.layer;
+	vec3 positionOffset = draw.positionOffset.xyz;
+	vec3 positionScale = draw.positionScale.xyz;
+	vec2 textureOffset = draw.textureOffset;
+	vec2 textureScale = draw.textureScale;
+#endif
+	vec3 position = positionOffset + vertexPosition * positionScale;
+
+	mat4 instanceModelView = ModelView * instanceTransform;
+	mat4 instanceModel = Model * instanceTransform;
 
-	gl_Position = Projection * ModelView * vec4(vertexPosition, 1.0);
+	gl_Position = Projection * instanceModelView * vec4(position, 1.0);
 
-	UV = vertexUV;
+	UV = textureOffset + vertexUV * textureScale;
+	color = vertexColor;
 
-	vertexPosition_world = (Model * vec4(vertexPosition, 1.0)).xyz;
+	vertexPosition_world = (instanceModel * vec4(position, 1.0)).xyz;
 
-	vertexNormal_camera = (ModelView * vec4(vertexNormal, 0.0)).xyz;
+	vertexNormal_camera = (instanceModelView * vec4(vertexNormal, 0.0)).xyz;
 
-	vec3 vertexPosition_camera = (ModelView * vec4(vertexPosition, 1.0)).xyz;
+	vec3 vertexPosition_camera = (instanceModelView * vec4(position, 1.0)).xyz;
 	cameraDirection_camera = vec3(0, 0, 0) - vertexPosition_camera;
 
 	vec3 lightPosition_camera = (View * vec4(lightPosition, 1.0)).xyz;
@@ -0,0 +1,248 @@
+#include "writer.h"
+
+#include <cstdio> // fopen fwrite
+#include <charconv> // to_chars
+#include <thread> // thread hardware_concurrency
+#include <atomic> // atomic
+#include <future> // async future
+#include <functional> // function
+#include <filesystem> // path
+#include <algorithm> // find min max
+#include "geometry.h" // weld
+
+namespace obj_viewer {
+
+	static const size_t chunk_size = 1 << 16;
+
+	class indexed_mesh {
+	public:
+		const mesh* source;
+		std::string name;
+		vertices welded;
+		std::vector<std::uint32_t> welded_indices;
+		size_t base;
+
+		const obj_viewer::vertices& output_vertices() const {
+			return source->indices.empty() ? welded : source->vertices;
+		}
+
+		const std::vector<std::uint32_t>& output_indices() const {
+			return source->indices.empty() ? welded_indices : source->indices;
+		}
+	};
+
+	typedef std::function<void(std::string&, size_t, size_t)> formatter;
+
+	static void append(std::string& out, float value) {
+		char buffer[32];
+		const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		out.append(buffer, result.ptr);
+	}
+
+	static void append(std::string& out, size_t value) {
+		char buffer[24];
+		const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		out.append(buffer, result.ptr);
+	}
+
+	static bool write_chunked(FILE* fp, size_t count, const formatter& format) {
+		const size_t chunks = (count + chunk_size - 1) / chunk_size;
+		const size_t workers = std::max(1u, std::thread::hardware_concurrency());
+		const size_t batch = workers * 2;
+
+		std::vector<std::string> formatted(batch), writing(batch);
+		std::future<bool> pending = std::async(std::launch::deferred, []() { return true; });
+
+		for (size_t first = 0; first < chunks; first += batch) {
+			const size_t last = std::min(chunks, first + batch);
+			std::atomic<size_t> next(first);
+			std::vector<std::thread> threads;
+			for (size_t w = 0; w < std::min(workers, last - first); ++w) {
+				threads.emplace_back([&]() {
+					for (size_t c = next++; c < last; c = next++) {
+						std::string& out = formatted[c - first];
+						out.clear();
+						format(out, c * chunk_size, std::min(count, (c + 1) * chunk_size));
+					}
+				});
+			}
+			for (auto& thread : threads)
+				thread.join();
+
+			if (!pending.get())
+				return false;
+			writing.swap(formatted);
+			const size_t written = last - first;
+			pending = std::async(std::launch::async, [fp, &writing, written]() {
+				for (size_t c = 0; c < written; ++c) {
+					if (fwrite(writing[c].data(), 1, writing[c].size(), fp) != writing[c].size())
+						return false;
+				}
+				return true;
+			});
+		}
+		return pending.get();
+	}
+
+	static bool write_text(FILE* fp, const std::string& text) {
+		return fwrite(text.data(), 1, text.size(), fp) == text.size();
+	}
+
+	static bool same_material(const mesh& a, const mesh& b) {
+		return a.material.diffuse == b.material.diffuse && a.material.specular == b.material.specular && a.material.ambient == b.material.ambient
+			&& a.material.shininess == b.material.shininess && a.texture_filepath == b.texture_filepath;
+	}
+
+	// the mtl file is keyed by name, so a name reused by different material content gets a numbered suffix
+	static std::string unique_material_name(const std::vector<indexed_mesh>& meshes, size_t m) {
+		const std::string base = meshes[m].name;
+		std::string name = base;
+		for (size_t suffix = 1;; ++suffix) {
+			bool conflict = false;
+			for (size_t i = 0; i < m && !conflict; ++i)
+				conflict = meshes[i].name == name && !same_material(*meshes[i].source, *meshes[m].source);
+			if (!conflict)
+				return name;
+			name = base + "_" + std::to_string(suffix);
+		}
+	}
+
+	static bool write_mtl(const std::string& filepath, const std::vector<indexed_mesh>& meshes) {
+		const std::filesystem::path directory = std::filesystem::absolute(filepath).parent_path();
+		std::string out;
+		std::vector<std::string> written;
+
+		for (const indexed_mesh& mesh : meshes) {
+			const material& material = mesh.source->material;
+			if (std::find(written.begin(), written.end(), mesh.name) != written.end())
+				continue;
+			written.push_back(mesh.name);
+
+			out += "newmtl " + mesh.name + "\nKa ";
+			append(out, material.ambient.x); out += ' '; append(out, material.ambient.y); out += ' '; append(out, material.ambient.z);
+			out += "\nKd ";
+			append(out, material.diffuse.x); out += ' '; append(out, material.diffuse.y); out += ' '; append(out, material.diffuse.z);
+			out += "\nKs ";
+			append(out, material.specular.x); out += ' '; append(out, material.specular.y); out += ' '; append(out, material.specular.z);
+			out += "\nNs ";
+			append(out, material.shininess);
+			out += '\n';
+			if (!mesh.source->texture_filepath.empty())
+				out += "map_Kd " + std::filesystem::absolute(mesh.source->texture_filepath).lexically_relative(directory).generic_string() + '\n';
+			out += '\n';
+		}
+
+		FILE* fp = fopen(filepath.c_str(), "wb");
+		if (fp == NULL)
+			return false;
+		const bool result = write_text(fp, out);
+		fclose(fp);
+		return result;
+	}
+
+	bool write_obj(const std::string& filepath, const std::vector<const object*>& objects) {
+		std::vector<indexed_mesh> meshes;
+		for (const object* obj : objects) {
+			for (const mesh& mesh : *obj->meshes)
+				meshes.push_back({ &mesh, mesh.material.name, vertices(0), {}, 0 });
+		}
+
+		size_t base = 1;
+		for (size_t m = 0; m < meshes.size(); ++m) {
+			indexed_mesh& mesh = meshes[m];
+			if (mesh.source->indices.empty()) {
+				mesh.welded = mesh.source->vertices;
+				mesh.welded_indices = weld(mesh.welded);
+			}
+			mesh.base = base;
+			base += mesh.output_vertices().positions.size();
+			if (mesh.name.empty())
+				mesh.name = "material_" + std::to_string(m);
+			mesh.name = unique_material_name(meshes, m);
+		}
+
+		const std::filesystem::path mtl_filepath = std::filesystem::path(filepath).replace_extension(".mtl");
+		if (!write_mtl(mtl_filepath.string(), meshes))
+			return false;
+
+		FILE* fp = fopen(filepath.c_str(), "wb");
+		if (fp == NULL)
+			return false;
+
+		bool result = write_text(fp, "mtllib " + mtl_filepath.filename().string() + "\n");
+		size_t texture_base = 1;
+		size_t normal_base = 1;
+		for (size_t m = 0; m < meshes.size(); ++m) {
+			const indexed_mesh& mesh = meshes[m];
+			const vertices& vertices = mesh.output_vertices();
+			const std::vector<std::uint32_t>& indices = mesh.output_indices();
+			const size_t count = vertices.positions.size();
+			const unsigned streams = vertices.streams();
+
+			result = result && write_text(fp, "o mesh_" + std::to_string(m) + "\n");
+			result = result && write_chunked(fp, count, [&vertices, streams](std::string& out, size_t begin, size_t end) {
+				out.reserve((end - begin) * 64);
+				for (size_t i = begin; i < end; ++i) {
+					const glm::vec3& p = vertices.positions[i];
+					out += "v ";
+					append(out, p.x); out += ' '; append(out, p.y); out += ' '; append(out, p.z);
+					if (streams & stream_colors) {
+						const std::uint32_t c = vertices.colors[i];
+						for (int shift = 0; shift < 24; shift += 8) {
+							out += ' ';
+							append(out, float((c >> shift) & 0xff) / 255.0f);
+						}
+					}
+					out += '\n';
+				}
+			});
+			result = result && write_chunked(fp, streams & stream_texture_coordinates ? count : 0, [&vertices](std::string& out, size_t begin, size_t end) {
+				out.reserve((end - begin) * 28);
+				for (size_t i = begin; i < end; ++i) {
+					const glm::vec2& t = vertices.texture_coordinates[i];
+					out += "vt ";
+					append(out, t.x); out += ' '; append(out, t.y);
+					out += '\n';
+				}
+			});
+			result = result && write_chunked(fp, streams & stream_normals ? count : 0, [&vertices](std::string& out, size_t begin, size_t end) {
+				out.reserve((end - begin) * 40);
+				for (size_t i = begin; i < end; ++i) {
+					const glm::vec3& n = vertices.normals[i];
+					out += "vn ";
+					append(out, n.x); out += ' '; append(out, n.y); out += ' '; append(out, n.z);
+					out += '\n';
+				}
+			});
+
+			result = result && write_text(fp, "usemtl " + mesh.name + "\n");
+			const size_t base = mesh.base;
+			result = result && write_chunked(fp, indices.size() / 3, [&indices, base, texture_base, normal_base, streams](std::string& out, size_t begin, size_t end) {
+				out.reserve((end - begin) * 64);
+				for (size_t f = begin; f < end; ++f) {
+					out += 'f';
+					for (size_t v = 0; v < 3; ++v) {
+						const size_t index = indices[f * 3 + v];
+						out += ' ';
+						append(out, base + index);
+						if (streams & (stream_normals | stream_texture_coordinates))
+							out += '/';
+						if (streams & stream_texture_coordinates)
+							append(out, texture_base + index);
+						if (streams & stream_normals) {
+							out += '/'; append(out, normal_base + index);
+						}
+					}
+					out += '\n';
+				}
+			});
+			if (streams & stream_texture_coordinates)
+				texture_base += count;
+			if (streams & stream_normals)
+				normal_base += count;
+		}
+
+		fclose(fp);
+		return result;
+	}
+}
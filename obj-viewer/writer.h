@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string> // string
+#include <vector> // vector
+#include "object.h" // object
+
+namespace obj_viewer {
+
+	bool write_obj(const std::string& filepath, const std::vector<const object*>& objects);
+}